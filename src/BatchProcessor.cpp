@@ -0,0 +1,312 @@
+/* Author: Cornelius Marx
+ */
+#include "BatchProcessor.h"
+#include "ModelViewer.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <cerrno>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace zer0;
+
+typedef std::chrono::steady_clock Clock;
+
+struct BatchProcessor::PreviewQueue{
+	/* model and approximation of a finished job, owned by the queue until rendered */
+	struct Item{
+		size_t job;
+		Mesh::OBJData * obj;
+		DynamicMesh * mesh;
+	};
+	std::mutex mutex;
+	std::condition_variable itemAdded;
+	std::condition_variable itemTaken;
+	std::deque<Item> items;
+	size_t maxItems;// workers wait while the queue is full, so pending models do not pile up if rendering is slower than decimation
+};
+
+/* seconds passed since given time point */
+static float secondsSince(const Clock::time_point & t)
+{
+	return std::chrono::duration<float>(Clock::now()-t).count();
+}
+
+/* get filename without directory and extension */
+static std::string getBaseName(const std::string & path)
+{
+	size_t slash = path.find_last_of('/');
+	std::string name = (slash == std::string::npos) ? path : path.substr(slash+1);
+	size_t dot = name.find_last_of('.');
+	if(dot != std::string::npos && dot > 0){
+		name = name.substr(0, dot);
+	}
+	return name;
+}
+
+bool BatchProcessor::addDirectory(const std::string & dir, int num_spheres)
+{
+	DIR * d = opendir(dir.c_str());
+	if(d == NULL){
+		ERROR("Unable to open directory '%s'.", dir.c_str());
+		return false;
+	}
+	std::vector<std::string> files;
+	struct dirent * entry;
+	while((entry = readdir(d)) != NULL){
+		std::string name(entry->d_name);
+		if(name.size() > 4 && name.compare(name.size()-4, 4, ".obj") == 0){
+			files.push_back(dir + "/" + name);
+		}
+	}
+	closedir(d);
+
+	// process in a reproducible order
+	std::sort(files.begin(), files.end());
+	for(const std::string & f : files){
+		_jobs.push_back(Job(f, num_spheres));
+	}
+	return true;
+}
+
+bool BatchProcessor::addManifest(const std::string & manifest_file, int default_num_spheres)
+{
+	std::ifstream f(manifest_file);
+	if(!f.good()){
+		ERROR("Unable to open manifest '%s'.", manifest_file.c_str());
+		return false;
+	}
+	size_t slash = manifest_file.find_last_of('/');
+	std::string base_dir = (slash == std::string::npos) ? "." : manifest_file.substr(0, slash);
+
+	std::string line;
+	int line_number = 0;
+	while(std::getline(f, line)){
+		line_number++;
+		std::istringstream line_stream(line);
+		std::string file;
+		if(!(line_stream >> file) || file[0] == '#'){// empty line or comment
+			continue;
+		}
+		int num_spheres = default_num_spheres;
+		std::string spheres;
+		if(line_stream >> spheres){
+			try{
+				num_spheres = std::stoi(spheres);
+			}catch(const std::exception&){
+				ERROR("Manifest '%s' line %d: Unable to convert '%s' to number of spheres.",
+						manifest_file.c_str(), line_number, spheres.c_str());
+				return false;
+			}
+		}
+		if(file[0] != '/'){
+			file = base_dir + "/" + file;
+		}
+		_jobs.push_back(Job(file, num_spheres));
+	}
+	return true;
+}
+
+bool BatchProcessor::run(int num_threads, const std::string & output_dir)
+{
+	if(num_threads <= 0){
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	num_threads = std::min(num_threads, (int)_jobs.size());
+	if(mkdir(output_dir.c_str(), 0755) != 0 && errno != EEXIST){
+		ERROR("Unable to create output directory '%s'.", output_dir.c_str());
+		return false;
+	}
+
+	// assign unique output files
+	_results.clear();
+	_results.resize(_jobs.size());
+	std::set<std::string> used_names;
+	for(size_t i = 0; i < _jobs.size(); i++){
+		std::string name = getBaseName(_jobs[i].file);
+		if(!used_names.insert(name).second){
+			name += "_" + std::to_string(i);
+			used_names.insert(name);
+		}
+		_results[i].outputFile = output_dir + "/" + name + ".sph";
+		if(_previews){
+			_results[i].previewFile = output_dir + "/" + name + ".ppm";
+		}
+	}
+
+	INFO("Processing %lu models on %d threads...", _jobs.size(), num_threads);
+	Clock::time_point t = Clock::now();
+	// every worker takes the next unprocessed job until all jobs are done
+	std::atomic<size_t> next_job(0);
+	std::vector<std::thread> workers;
+	PreviewQueue previews;
+	previews.maxItems = num_threads;
+	for(int i = 0; i < num_threads; i++){
+		workers.push_back(std::thread([&](){
+			DynamicMesh mesh;
+			size_t job;
+			while((job = next_job++) < _jobs.size()){
+				if(!_previews){
+					Mesh::OBJData obj;
+					process(_jobs[job], obj, mesh, _results[job]);
+					mesh.clear();
+					continue;
+				}
+				// model and approximation are handed over to the rendering thread, so every job gets its own
+				PreviewQueue::Item item = {job, new Mesh::OBJData, new DynamicMesh};
+				process(_jobs[job], *item.obj, *item.mesh, _results[job]);
+				{
+					std::unique_lock<std::mutex> lock(previews.mutex);
+					previews.itemTaken.wait(lock, [&](){return previews.items.size() < previews.maxItems;});
+					previews.items.push_back(item);
+				}
+				previews.itemAdded.notify_one();
+			}
+		}));
+	}
+	if(_previews){
+		renderPreviews(previews);
+	}
+	for(std::thread & w : workers){
+		w.join();
+	}
+
+	writeSummary(output_dir + "/summary.txt", secondsSince(t));
+
+	for(const Result & r : _results){
+		if(!r.success){
+			return false;
+		}
+	}
+	return true;
+}
+
+void BatchProcessor::process(const Job & job, Mesh::OBJData & obj, DynamicMesh & mesh, Result & result)
+{
+	INFO("-> '%s' (%d spheres)", job.file.c_str(), job.numSpheres);
+	Clock::time_point t = Clock::now();
+	// normals are only needed to render the model
+	if(!Mesh::parseOBJFromFile(job.file.c_str(), _previews ? Mesh::NORMAL : Mesh::ONLY_POSITION, obj)){
+		ERROR("Failed to load '%s'.", job.file.c_str());
+		return;
+	}
+	result.loadTime = secondsSince(t);
+	result.inputVertices = obj.vertices.size();
+	result.inputFaces = obj.indices.size()/3;
+	if(result.inputFaces == 0){
+		ERROR("'%s' does not contain any faces.", job.file.c_str());
+		return;
+	}
+
+	t = Clock::now();
+	mesh.set(obj.vertices, obj.indices);
+	mesh.initSQEM();
+	mesh.sphereApproximation(job.numSpheres);
+	result.approximationTime = secondsSince(t);
+
+	result.numSpheres = mesh.getVertexList().getSize();
+	result.numEdges = mesh.getEdgeList().getSize();
+	result.numFaces = mesh.getFaceList().getSize();
+	result.success = mesh.saveSphereMesh(result.outputFile.c_str());
+}
+
+void BatchProcessor::renderPreviews(PreviewQueue & queue)
+{
+	ModelViewer viewer;
+	viewer.initPreview();
+	PixelReader reader;
+	std::deque<size_t> reading;// jobs with pending reads, oldest first
+	std::vector<unsigned char> pixels;
+	auto write_oldest = [&](){
+		int w, h;
+		size_t job = reading.front();
+		reading.pop_front();
+		if(!reader.fetch(pixels, w, h) || !PixelReader::writePPM(_results[job].previewFile.c_str(), pixels.data(), w, h)){
+			_results[job].success = false;
+		}
+	};
+	for(size_t num_done = 0; num_done < _jobs.size(); num_done++){
+		PreviewQueue::Item item;
+		{
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			queue.itemAdded.wait(lock, [&](){return !queue.items.empty();});
+			item = queue.items.front();
+			queue.items.pop_front();
+		}
+		queue.itemTaken.notify_one();
+		// reads requested before waiting have most likely finished while the workers were busy
+		while(!reading.empty() && reader.isReady()){
+			write_oldest();
+		}
+		if(_results[item.job].success){
+			viewer.setPreview(*item.obj, *item.mesh);
+			FW->renderFrame(&viewer);
+			if(reader.getNumPending() == ZER0_PIXEL_READER_BUFFERS){
+				write_oldest();
+			}
+			reader.request(0, 0, FW->getWindowW(), FW->getWindowH());
+			reading.push_back(item.job);
+		}
+		delete item.obj;
+		delete item.mesh;
+	}
+	while(!reading.empty()){
+		write_oldest();
+	}
+}
+
+void BatchProcessor::writeSummary(const std::string & summary_file, float total_time)
+{
+	size_t name_width = 5;
+	for(const Job & j : _jobs){
+		name_width = std::max(name_width, j.file.size());
+	}
+
+	std::vector<std::string> lines;
+	char buffer[256];
+	std::string header = "model";
+	header.resize(name_width, ' ');
+	header += "  vertices     faces  spheres    edges    faces  load[s]  approx[s]  status";
+	lines.push_back(header);
+	lines.push_back(std::string(header.size(), '-'));
+	int num_failed = 0;
+	for(size_t i = 0; i < _jobs.size(); i++){
+		const Result & r = _results[i];
+		std::string l = _jobs[i].file;
+		l.resize(name_width, ' ');
+		snprintf(buffer, sizeof(buffer), "  %8lu  %8lu  %7lu  %7lu  %7lu  %7.3f  %9.3f  ",
+				r.inputVertices, r.inputFaces, r.numSpheres, r.numEdges, r.numFaces, r.loadTime, r.approximationTime);
+		l += buffer;
+		l += r.success ? "ok" : "FAILED";
+		lines.push_back(l);
+		if(!r.success){
+			num_failed++;
+		}
+	}
+	snprintf(buffer, sizeof(buffer), "%lu models, %d failed, took %.3f seconds", _jobs.size(), num_failed, total_time);
+	lines.push_back(buffer);
+
+	FILE * f = fopen(summary_file.c_str(), "w");
+	if(f == NULL){
+		ERROR("Unable to open file '%s' for writing.", summary_file.c_str());
+	}
+	INFO("\nSummary:");
+	for(const std::string & l : lines){
+		INFO("%s", l.c_str());
+		if(f != NULL){
+			fprintf(f, "%s\n", l.c_str());
+		}
+	}
+	if(f != NULL){
+		fclose(f);
+		INFO("Summary written to '%s'.", summary_file.c_str());
+	}
+}
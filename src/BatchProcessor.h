@@ -0,0 +1,98 @@
+/* Author: Cornelius Marx
+ */
+#ifndef BATCH_PROCESSOR_H
+#define BATCH_PROCESSOR_H
+
+#include <string>
+#include <vector>
+#include "DynamicMesh.h"
+
+/**
+ * Runs the sphere mesh approximation for many models without opening a window.
+ * Jobs are distributed over a pool of worker threads, every worker uses its own DynamicMesh.
+ */
+class BatchProcessor
+{
+public:
+	BatchProcessor(): _previews(false){}
+
+	/* single model to approximate */
+	struct Job{
+		Job(const std::string & f, int n): file(f), numSpheres(n){}
+		std::string file;
+		int numSpheres;
+	};
+
+	/* outcome of a job, filled in by the worker that processed it */
+	struct Result{
+		Result(): success(false), inputVertices(0), inputFaces(0),
+				numSpheres(0), numEdges(0), numFaces(0),
+				loadTime(0), approximationTime(0){}
+		bool success;
+		std::string outputFile;
+		std::string previewFile; // empty if previews are disabled
+		size_t inputVertices;
+		size_t inputFaces;
+		size_t numSpheres;
+		size_t numEdges;
+		size_t numFaces;
+		float loadTime; // seconds spent parsing the model
+		float approximationTime; // seconds spent in initSQEM() and sphereApproximation()
+	};
+
+	/*
+	 * add all .obj files in given directory (not recursive)
+	 * @return false if directory could not be read
+	 */
+	bool addDirectory(const std::string & dir, int num_spheres);
+
+	/*
+	 * add all models listed in a manifest file
+	 * every line has the format '<obj file> [<num spheres>]', empty lines and lines starting with '#' are ignored
+	 * relative paths are relative to the directory of the manifest
+	 * @param default_num_spheres number of spheres for lines that do not specify it
+	 * @return false if manifest could not be read or contains invalid lines
+	 */
+	bool addManifest(const std::string & manifest_file, int default_num_spheres);
+
+	/*
+	 * process all jobs
+	 * @param num_threads number of worker threads, 0 for one thread per CPU core
+	 * @param output_dir directory to write sphere meshes and summary table to (created if it does not exist)
+	 * @return false if any job failed
+	 */
+	bool run(int num_threads, const std::string & output_dir);
+
+	/*
+	 * render an image of every model next to its sphere mesh (as shown by ModelViewer) to '<output_dir>/<name>.ppm'
+	 * the images are rendered by the thread calling run() while the workers continue with the next models,
+	 * so it needs a gl context with the size of the images (see Framework::createOffscreen())
+	 */
+	void setPreviews(bool enable){_previews = enable;}
+
+	const std::vector<Job>& getJobs()const{return _jobs;}
+	const std::vector<Result>& getResults()const{return _results;}
+
+private:
+	/* finished jobs handed from the workers to the thread rendering previews */
+	struct PreviewQueue;
+
+	/*
+	 * process single job, called from worker threads
+	 * @param obj set to the parsed model
+	 * @param mesh set to the approximation
+	 */
+	void process(const Job & job, zer0::Mesh::OBJData & obj, DynamicMesh & mesh, Result & result);
+
+	/* render and write previews of all jobs as they are finished by the workers */
+	void renderPreviews(PreviewQueue & queue);
+
+	/* print summary table of all results and write it to given file */
+	void writeSummary(const std::string & summary_file, float total_time);
+
+	std::vector<Job> _jobs;
+	std::vector<Result> _results;
+	bool _previews;
+};
+
+#endif
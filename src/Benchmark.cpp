@@ -0,0 +1,162 @@
+/* Author: Cornelius Marx
+ */
+#include "Benchmark.h"
+#include <chrono>
+#include <algorithm>
+#include <vector>
+/* configuration */
+#define CAMERA_FOV              70
+#define CAMERA_PITCH            0.4   /* angle in radians the model is viewed from above while orbiting */
+#define BACKGROUND_COLOR        0x303030FF
+#define SPHERE_COLOR            0xff922cFF
+#define CYLINDER_COLOR          0xa0a0a0FF
+#define TRIANGLE_COLOR          0xa0a0efFF
+#define MIN_SPHERE_RADIUS       0.001
+#define MIN_CYLINDER_RADIUS     0.001
+#define SPHERE_RADIUS_OFFSET    0.0008
+/*****************/
+
+using namespace zer0;
+
+typedef std::chrono::steady_clock Clock;
+
+/* value below which the given fraction of the sorted values lies */
+template<typename T>
+static T getPercentile(const std::vector<T> & sorted, float fraction)
+{
+	size_t i = std::min(sorted.size()-1, (size_t)(fraction*sorted.size()));
+	return sorted[i];
+}
+
+Benchmark::Benchmark():
+	_numSegments(0),
+	_sphereMesh(SPHERE_RADIUS_OFFSET)
+{
+}
+
+bool Benchmark::init(const std::string & model_file, int num_spheres, int num_segments)
+{
+	_modelFilename = model_file;
+	_numSegments = num_segments;
+	Color bg_color(BACKGROUND_COLOR);
+	glClearColor(bg_color.r, bg_color.g, bg_color.b, bg_color.a);
+	glCullFace(GL_BACK);
+	_shader.init();
+	_shader.use();
+	_shader.setLightDir(Vector3D(1.0, 1.5, 1.3).getNormalized());
+	_shader.setLightMode(DiffuseShader::MATCAP);
+
+	INFO("Loading mesh from '%s'...", _modelFilename.c_str());
+	Mesh::OBJData obj;
+	if(!Mesh::parseOBJFromFile(_modelFilename.c_str(), Mesh::ONLY_POSITION, obj)){
+		return false;
+	}
+	INFO("-> Approximating with %d spheres...", num_spheres);
+	_dynamicMesh.set(obj.vertices, obj.indices);
+	_dynamicMesh.initSQEM();
+	_dynamicMesh.sphereApproximation(num_spheres);
+
+	_sphereMesh.setColors(Color(SPHERE_COLOR), Color(CYLINDER_COLOR), Color(TRIANGLE_COLOR));
+	_sphereMesh.setPosition(-_dynamicMesh.getCenterPos());
+	_sphereMesh.init(_dynamicMesh, _numSegments, MIN_SPHERE_RADIUS, MIN_CYLINDER_RADIUS);
+
+	_projectionMat.setPerspectiveY(CAMERA_FOV, FW->getWindowAspectWH(), 0.1, 100);
+	_camera.rotate(CAMERA_PITCH, 0);
+	return true;
+}
+
+void Benchmark::render(int viewport)
+{
+	SHADER->setProjectionMatrix(_projectionMat);
+	_camera.upload();
+	Matrix4 view;
+	_camera.getViewMatrix(view);
+	_sphereMesh.updateLOD(view, _projectionMat, FW->getWindowH());
+	// same as SphereMesh::draw(), but every component is counted on its own
+	for(int c = 0; c < NUM_COMPONENTS; c++){
+		RenderStatistics before = Mesh::getStatistics();
+		switch(c){
+		case SPHERES:	_sphereMesh.drawSpheres(); break;
+		case CYLINDERS:	_sphereMesh.drawCylinders(); break;
+		case TRIANGLES:	_sphereMesh.drawTriangles(); break;
+		}
+		RenderStatistics s = Mesh::getStatistics() - before;
+		RenderStatistics & sum = _componentStatistics[c];
+		sum.drawCalls += s.drawCalls;
+		sum.binds += s.binds;
+		sum.vertices += s.vertices;
+		sum.indices += s.indices;
+		sum.triangles += s.triangles;
+	}
+}
+
+void Benchmark::run(int num_frames)
+{
+	std::vector<float> frame_times(num_frames);
+	std::vector<RenderStatistics> frame_stats(num_frames);
+	// first frame records vertex array objects and uploads levels of detail, it is not measured
+	FW->renderFrame(this);
+	glFinish();
+	for(RenderStatistics & s : _componentStatistics){
+		s.reset();
+	}
+	for(int i = 0; i < num_frames; i++){
+		_camera.rotate(0, 2*M_PI/num_frames);
+		Mesh::getStatistics().reset();
+		Clock::time_point t = Clock::now();
+		FW->renderFrame(this);
+		glFinish();
+		frame_times[i] = std::chrono::duration<float, std::milli>(Clock::now()-t).count();
+		frame_stats[i] = Mesh::getStatistics();
+	}
+
+	std::vector<float> sorted_times(frame_times);
+	std::sort(sorted_times.begin(), sorted_times.end());
+	float total_time = 0;
+	for(float t : frame_times){
+		total_time += t;
+	}
+	// every counter is sorted on its own for the distribution
+	const int num_counters = 7;
+	const char * names[num_counters] = {"draw calls:", "binds:", "vertices:", "indices:", "triangles:", "uploaded bytes:", "allocations:"};
+	std::vector<size_t> values[num_counters];
+	for(const RenderStatistics & s : frame_stats){
+		size_t v[num_counters] = {s.drawCalls, s.binds, s.vertices, s.indices, s.triangles, s.uploadedBytes, s.bufferAllocations};
+		for(int i = 0; i < num_counters; i++){
+			values[i].push_back(v[i]);
+		}
+	}
+	for(std::vector<size_t> & v : values){
+		std::sort(v.begin(), v.end());
+	}
+
+	INFO("\nBenchmark:\n"
+	     "  -> model:            %s\n"
+	     "  -> sphere mesh:      %lu spheres, %lu edges, %lu faces\n"
+	     "  -> segments:         %d\n"
+	     "  -> frames:           %d at %dx%d\n"
+	     "  -> OpenGL:           %s (%s)\n",
+		 _modelFilename.c_str(),
+		 _dynamicMesh.getVertexList().getSize(), _dynamicMesh.getEdgeList().getSize(), _dynamicMesh.getFaceList().getSize(),
+		 _numSegments, num_frames, FW->getWindowW(), FW->getWindowH(),
+		 (const char*)glGetString(GL_VERSION), (const char*)glGetString(GL_RENDERER));
+	INFO("  frame time [ms]:  min %8.3f  median %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f  mean %8.3f (%.1f fps)",
+		 sorted_times.front(), getPercentile(sorted_times, 0.5f), getPercentile(sorted_times, 0.9f),
+		 getPercentile(sorted_times, 0.99f), sorted_times.back(), total_time/num_frames, num_frames*1000.f/total_time);
+	for(int i = 0; i < num_counters; i++){
+		size_t sum = 0;
+		for(size_t v : values[i]){
+			sum += v;
+		}
+		INFO("  %-16s min %8lu  median %8lu  max %8lu  mean %10.1f per frame",
+			 names[i], values[i].front(), getPercentile(values[i], 0.5f), values[i].back(), sum/(double)num_frames);
+	}
+	const char * component_names[NUM_COMPONENTS] = {"spheres:", "cylinders:", "triangles:"};
+	INFO("  mean per frame by component:");
+	for(int c = 0; c < NUM_COMPONENTS; c++){
+		const RenderStatistics & s = _componentStatistics[c];
+		INFO("    %-12s %8.1f draw calls  %8.1f binds  %10.1f vertices  %10.1f indices  %10.1f triangles",
+			 component_names[c], s.drawCalls/(double)num_frames, s.binds/(double)num_frames,
+			 s.vertices/(double)num_frames, s.indices/(double)num_frames, s.triangles/(double)num_frames);
+	}
+}
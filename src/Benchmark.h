@@ -0,0 +1,48 @@
+/* Author: Cornelius Marx
+ */
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "zer0engine/zer0engine.h"
+#include "DiffuseShader.h"
+#include "DynamicMesh.h"
+#include "SphereMesh.h"
+#include <string>
+
+/**
+ * Measures how fast the sphere mesh of a model is drawn: the camera orbits around the model once
+ * while a given number of frames is rendered (e.g. offscreen, see Framework::createOffscreen()).
+ * Every frame waits for the gpu to finish, so the frame times also hold for software renderers.
+ */
+class Benchmark : public zer0::Application
+{
+public:
+	Benchmark();
+
+	/*
+	 * load and approximate model
+	 * @param num_segments number of segments of spheres and cylinders at the finest level of detail (see SphereMesh::init())
+	 * @return false if the model could not be loaded
+	 */
+	bool init(const std::string & model_file, int num_spheres, int num_segments);
+
+	/* render given number of frames and print frame time distribution and statistics per frame */
+	void run(int num_frames);
+
+	void render(int viewport)override;
+
+private:
+	std::string _modelFilename;
+	int _numSegments;
+	DynamicMesh _dynamicMesh;
+	SphereMesh _sphereMesh;
+	DiffuseShader _shader;
+	zer0::Camera _camera;
+	zer0::Matrix4 _projectionMat;
+
+	/* statistics of SphereMesh::drawSpheres(), drawCylinders() and drawTriangles() summed up over all measured frames */
+	enum Component{SPHERES, CYLINDERS, TRIANGLES, NUM_COMPONENTS};
+	zer0::RenderStatistics _componentStatistics[NUM_COMPONENTS];
+};
+
+#endif
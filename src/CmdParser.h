@@ -40,6 +40,7 @@ public:
 	CmdArg(const T& default_value);
 	~CmdArg()override{}
 	const T& getValue()const{return _value;}
+	bool isSet()const{return _isSet;}// true if argument was given on last parse
 	
 	friend class CmdParser;
 private:
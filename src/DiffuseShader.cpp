@@ -2,21 +2,40 @@
 
 static const char * VERTEX_SOURCE =
 "#version 120\n"
+ZER0_SHADER_CAMERA_UNIFORMS
 "attribute vec3 vertex;\n"
 "attribute vec4 color;\n"
 "attribute vec3 normal;\n"
+"attribute vec4 instance;\n" /* per-instance offset (xyz) and scale (w), (0,0,0,1) when not drawing instanced */
 "varying vec4 out_color;\n"
 "varying vec3 out_normal;\n"
 "varying vec3 out_screen_normal;\n"
-"uniform mat4 projMat;\n"
-"uniform mat4 viewMat;\n"
+"varying vec3 out_position;\n"
+"varying vec3 out_view_position;\n"
 "uniform mat4 modelMat;\n"
 "uniform float normal_offset = 0.0;\n"
+/* decoding of quantized vertices (see zer0::Mesh::setQuantization()) */
+"uniform vec3 vertex_offset = vec3(0.0);\n"
+"uniform vec3 vertex_scale = vec3(1.0);\n"
+"uniform bool oct_normals = false;\n"
+"vec3 decodeOctahedral(vec2 e)\n"
+"{\n"
+"	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+"	if(n.z < 0.0){\n"
+"		n.xy = (1.0 - abs(n.yx))*vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+"	}\n"
+"	return normalize(n);\n"
+"}\n"
 "void main()\n"
 "{\n"
-"	gl_Position = projMat * viewMat * modelMat * vec4((vertex+normal*normal_offset), 1);\n"
+"	vec3 n = oct_normals ? decodeOctahedral(normal.xy) : normal;\n"
+"	vec3 v = vertex_offset + vertex*vertex_scale;\n"
+"	vec4 world_pos = modelMat * vec4((v*instance.w + instance.xyz + n*normal_offset), 1);\n"
+"	out_position = world_pos.xyz;\n"
+"	out_view_position = (viewMat*world_pos).xyz;\n"
+"	gl_Position = projMat * viewMat * world_pos;\n"
 "	out_color = color;\n"
-"	out_normal = (modelMat*vec4(normal,0)).xyz;\n"
+"	out_normal = (modelMat*vec4(n,0)).xyz;\n"
 "   out_screen_normal = (viewMat*vec4(out_normal,0)).xyz;\n"
 "}\n"
 ;
@@ -26,6 +45,9 @@ static const char * FRAGMENT_SOURCE =
 "varying vec4 out_color;\n"
 "varying vec3 out_normal;\n"
 "varying vec3 out_screen_normal;\n"
+"varying vec3 out_position;\n"
+"varying vec3 out_view_position;\n"
+"uniform bool flat_normals = false;\n"
 "uniform vec3 ambient_light = vec3(0.3,0.3,0.3);\n"
 "uniform vec3 light_dir = vec3(1,1,1);\n"
 "uniform vec3 light_color = vec3(1,1,1);\n"
@@ -33,11 +55,18 @@ static const char * FRAGMENT_SOURCE =
 "float dot(vec3 a, vec3 b){return a.x*b.x + a.y*b.y + a.z*b.z;}\n"
 "void main()\n"
 "{\n"
+"   vec3 normal = out_normal;\n"
+"   vec3 screen_normal = out_screen_normal;\n"
+/* face normal from the screen space derivatives of the position, points towards the viewer */
+"   if(flat_normals){\n"
+"       normal = cross(dFdx(out_position), dFdy(out_position));\n"
+"       screen_normal = cross(dFdx(out_view_position), dFdy(out_view_position));\n"
+"   }\n"
 "   if(light_enabled == 1){\n"
-"       vec3 l = max(0,dot(light_dir,normalize(out_normal)))*light_color;\n"
+"       vec3 l = max(0,dot(light_dir,normalize(normal)))*light_color;\n"
 "       gl_FragColor = vec4((ambient_light + l)*out_color.rgb, out_color.a);\n"
 "   }else if(light_enabled == 2){\n"
-"		float f = normalize(out_screen_normal).z;\n"
+"		float f = normalize(screen_normal).z;\n"
 "       if(f < 0){f = -f;}\n"
 "       gl_FragColor = vec4(out_color.rgb*f, out_color.a);\n"
 "   }\n"
@@ -57,16 +86,20 @@ bool DiffuseShader::init()
 	setVertexLocation("vertex");
 	setColorLocation("color");
 	setNormalLocation("normal");
+	setInstanceLocation("instance");
 	setModelMatrixLocation("modelMat");
 	setViewMatrixLocation("viewMat");
 	setProjectionMatrixLocation("projMat");
+	setVertexDecodeLocations("vertex_offset", "vertex_scale", "oct_normals");
 	setColor(zer0::Color::WHITE);
+	setInstance(zer0::Vector4D(0, 0, 0, 1));
 
-	_lightDirLoc = getLocation("light_dir", true);
-	_ambientColorLoc = getLocation("ambient_light", true);
-	_lightColorLoc = getLocation("light_color", true);
-	_lightEnabledLoc = getLocation("light_enabled", true);
-	_normalOffsetLoc = getLocation("normal_offset", true);
+	_lightDir.setLocation(getLocation("light_dir", true));
+	_ambientColor.setLocation(getLocation("ambient_light", true));
+	_lightColor.setLocation(getLocation("light_color", true));
+	_lightEnabled.setLocation(getLocation("light_enabled", true));
+	_normalOffset.setLocation(getLocation("normal_offset", true));
+	_flatNormals.setLocation(getLocation("flat_normals", true));
 
 	return r;
 }
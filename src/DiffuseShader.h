@@ -7,44 +7,49 @@ class DiffuseShader : public zer0::Shader
 { 
 public:
 	DiffuseShader():
-		Shader("Diffuse-Shader"),
-		_lightDirLoc(-1),
-		_ambientColorLoc(-1),
-		_lightColorLoc(-1){}
+		Shader("Diffuse-Shader"){}
 
 	bool init();
 
 	/* set ambient light color */
 	void setAmbientColor(const zer0::Color & c){
-		glUniform3fv(_ambientColorLoc, 1, (float*)&c);	
+		_ambientColor.set(zer0::Vector3D(c.r, c.g, c.b));
 	}
 
 	/* set color of the directional light */
 	void setLightColor(const zer0::Color & c){
-		glUniform3fv(_lightColorLoc, 1, (float*)&c);	
+		_lightColor.set(zer0::Vector3D(c.r, c.g, c.b));
 	}
 
 	/* set light direction */
 	void setLightDir(const zer0::Vector3D & dir){
-		glUniform3fv(_lightDirLoc, 1, (float*)&dir);	
+		_lightDir.set(dir);
 	}
 
 	/* enabled/disable lighting */
 	enum LightMode{UNSHADED=0, STATIC_LIGHT=1, MATCAP=2};
 	void setLightMode(LightMode mode){
-		glUniform1i(_lightEnabledLoc, mode);
+		_lightEnabled.set(mode);
 	}
 
 	void setNormalOffset(float offset){
-		glUniform1f(_normalOffsetLoc, offset);
+		_normalOffset.set(offset);
+	}
+
+	/* shade every triangle with its face normal (derived from the positions in the fragment shader) instead of the vertex normals,
+	 * so meshes with shared vertices (e.g. DynamicMesh::SHARED_VERTICES) look like flat shaded meshes */
+	void setFlatShading(bool enabled){
+		_flatNormals.set(enabled);
 	}
 
 private:
-	GLint _lightDirLoc;
-	GLint _ambientColorLoc;
-	GLint _lightColorLoc;
-	GLint _lightEnabledLoc;
-	GLint _normalOffsetLoc;
+	/* uniforms only upload changed values, so setters can be called every draw */
+	zer0::Uniform<zer0::Vector3D> _lightDir;
+	zer0::Uniform<zer0::Vector3D> _ambientColor;
+	zer0::Uniform<zer0::Vector3D> _lightColor;
+	zer0::Uniform<int> _lightEnabled;
+	zer0::Uniform<float> _normalOffset;
+	zer0::Uniform<bool> _flatNormals;
 };
 
 #endif
@@ -1,4 +1,5 @@
 #include "DynamicMesh.h"
+#include <limits>
 
 using namespace zer0;
 
@@ -104,57 +105,69 @@ const DynamicMesh::Vertex* DynamicMesh::Face::getOtherVertex(const Vertex * not_
 	_FACE_OTHER_VERTEX;
 }
 
-DynamicMesh::DynamicMesh()
+DynamicMesh::DynamicMesh(): _trackChanges(false), _slotLayout(false)
 {
 }
 
 DynamicMesh::~DynamicMesh()
 {
+	clear();
 }
 
 void DynamicMesh::clear()
 {
+	// edges marked as 'removed' are no longer part of the edge list, they only live in the collapse list
+	while(!_collapseList.empty()){
+		Edge * e = _collapseList.top();
+		_collapseList.pop();
+		if(e->needs_removal){
+			delete e;
+		}
+	}
 	_vertexList.clear();
 	_edgeList.clear();
 	_faceList.clear();
+	clearChanges();
+	_trackChanges = false;
+	_slotLayout = false;
 }
 
 void DynamicMesh::debug_print()
 {
 	// debug print
 	int count = 0;
-	INFO("### VERTICIES ###");
+	VERBOSE("### VERTICIES ###");
 	for(const Vertex * v = _vertexList.getFirst(); v != nullptr; v = v->getNext())
 	{
-		INFO("verticies[%d]: %s", count, v->toString().c_str());
+		VERBOSE("verticies[%d]: %s", count, v->toString().c_str());
 		int e_count = 0;
 		for(const Edge * e : v->edges){
-			INFO("  edges[%d]: %s", e_count, e->toString().c_str());
+			VERBOSE("  edges[%d]: %s", e_count, e->toString().c_str());
 			e_count++;
 		}
 		count ++;
-		INFO(" ");
+		VERBOSE(" ");
 	}
-	INFO("### FACES ###");
+	VERBOSE("### FACES ###");
 	count = 0;
 	for(const Face * f = _faceList.getFirst(); f != nullptr; f = f->getNext())
 	{
-		INFO("faces[%d]: %s", count, f->toString().c_str());
+		VERBOSE("faces[%d]: %s", count, f->toString().c_str());
 		count ++;
-		INFO(" ");
+		VERBOSE(" ");
 	}
-	INFO("### EDGES ###");
+	VERBOSE("### EDGES ###");
 	count = 0;
 	for(const Edge * e = _edgeList.getFirst(); e != nullptr; e = e->getNext())
 	{
-		INFO("edges[%d]: %s", count, e->toString().c_str());
+		VERBOSE("edges[%d]: %s", count, e->toString().c_str());
 		int f_count = 0;
 		for(const Face * f : e->faces){
-			INFO("  faces[%d]: %s", f_count, f->toString().c_str());
+			VERBOSE("  faces[%d]: %s", f_count, f->toString().c_str());
 			f_count++;
 		}
 		count ++;
-		INFO(" ");
+		VERBOSE(" ");
 	}
 
 }
@@ -240,93 +253,275 @@ void DynamicMesh::set(const std::vector<Vector3D> & verticies, const std::vector
 	
 }
 
-void DynamicMesh::upload(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh)
+void DynamicMesh::upload(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh, UploadMode mode)
 {
-	static const int average_faces_per_vertex = 4;
-	// assign a unique id to every Vertex and store their positions in an array
+	// meshes no longer contain slots, uploadChanges() has to start over
+	_slotLayout = false;
+	// everything tracked so far is part of this upload
+	clearChanges();
+	if(mode == SHARED_VERTICES){
+		uploadShared(face_mesh, edge_mesh);
+		return;
+	}
+
+	// number of faces adjacent to every vertex (one-ring), vertices are temporarily numbered by their position in the vertex list
 	const size_t num_verts = _vertexList.getSize();
-	std::vector<VN> verts; 
-	verts.reserve(num_verts*average_faces_per_vertex);
+	std::vector<unsigned int> valence(num_verts, 0);
+	size_t id = 0;
+	for(Vertex * v = _vertexList.getFirst(); v != nullptr; v = v->getNext()){
+		v->id = id++;
+	}
+	for(Face * f = _faceList.getFirst(); f != nullptr; f = f->getNext()){
+		for(int i = 0; i < 3; i++){
+			valence[f->v[i]->id]++;
+		}
+	}
 
+	// every vertex occupies 1 + valence successive entries: the vertex with averaged normal (used by edges) followed by one entry per face
+	std::vector<size_t> first(num_verts+1, 0);
+	for(size_t i = 0; i < num_verts; i++){
+		first[i+1] = first[i] + 1 + valence[i];
+	}
+	const size_t v_size = first[num_verts];
+	std::vector<Vector3D> vert_norms(2*v_size, Vector3D(0, 0, 0));
+	Vector3D * normals = vert_norms.data() + v_size;
+
+	// single pass over all faces: normal is calculated once per face and written to the next free entry of each corner
+	std::vector<unsigned int> indices;
+	indices.reserve(3*_faceList.getSize());
+	for(Face * f = _faceList.getFirst(); f != nullptr; f = f->getNext()){
+		f->calculateNormal();
+		for(int i = 0; i < 3; i++){
+			size_t vi = f->v[i]->id;
+			size_t entry = first[vi] + valence[vi];
+			valence[vi]--;
+			normals[first[vi]] += f->normal;
+			normals[entry] = f->normal;
+			indices.push_back(entry);
+		}
+	}
 	for(Vertex * v = _vertexList.getFirst(); v != nullptr; v = v->getNext()){
-		v->id = verts.size();
+		size_t vi = v->id;
+		for(size_t entry = first[vi]; entry < first[vi+1]; entry++){
+			vert_norms[entry] = v->position;
+		}
+		if(normals[first[vi]].getLength() > 0){
+			normals[first[vi]].normalize();
+		}
+		v->id = first[vi];
+	}
+	face_mesh.set3DIndexed((float*)vert_norms.data(), v_size, indices.data(), indices.size(), Mesh::NORMAL, GL_TRIANGLES);
 
-		// get all faces from vertex
-		std::set<Face*> faces;
-		v->getFaces(faces);
-		Vector3D accum_normal(0,0,0);
-		for(Face * f : faces){// for each face add vertex with corresponding normal
-			f->calculateNormal();
-			accum_normal += f->normal;
+	// edge mesh uses the entries with averaged normals
+	indices.clear();
+	for(Edge * e = _edgeList.getFirst(); e != nullptr; e = e->getNext()){
+		indices.push_back(e->v[0]->id);
+		indices.push_back(e->v[1]->id);
+	}
+	edge_mesh.setShared(face_mesh, indices.data(), indices.size(), GL_LINES);
+}
+
+void DynamicMesh::uploadShared(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh)
+{
+	// first all positions then all normals, normals are accumulated over the adjacent faces
+	const size_t num_verts = _vertexList.getSize();
+	std::vector<Vector3D> vert_norms(2*num_verts, Vector3D(0, 0, 0));
+	Vector3D * normals = vert_norms.data() + num_verts;
+	size_t id = 0;
+	for(Vertex * v = _vertexList.getFirst(); v != nullptr; v = v->getNext()){
+		v->id = id;
+		vert_norms[id] = v->position;
+		id++;
+	}
+	std::vector<unsigned int> indices;
+	indices.reserve(3*_faceList.getSize());
+	for(Face * f = _faceList.getFirst(); f != nullptr; f = f->getNext()){
+		f->calculateNormal();
+		for(int i = 0; i < 3; i++){
+			normals[f->v[i]->id] += f->normal;
+			indices.push_back(f->v[i]->id);
 		}
-		verts.push_back(VN(v->position, accum_normal.getNormalized()));
-		for(Face * f : faces){
-			verts.push_back(VN(v->position, f->normal));
+	}
+	for(size_t i = 0; i < num_verts; i++){
+		if(normals[i].getLength() > 0){
+			normals[i].normalize();
 		}
 	}
-	
-	// face mesh
-	// iterate all faces and store vertex indices
-	const size_t num_indices = 3*_faceList.getSize();
-	unsigned int * indices = new unsigned int[num_indices];
-	int index_count = 0;
+	face_mesh.set3DIndexed((float*)vert_norms.data(), num_verts, indices.data(), indices.size(), Mesh::NORMAL, GL_TRIANGLES);
+
+	indices.clear();
+	for(Edge * e = _edgeList.getFirst(); e != nullptr; e = e->getNext()){
+		indices.push_back(e->v[0]->id);
+		indices.push_back(e->v[1]->id);
+	}
+	edge_mesh.setShared(face_mesh, indices.data(), indices.size(), GL_LINES);
+}
+
+void DynamicMesh::uploadSlots(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh)
+{
+	// face mesh: 3 vertices per slot, first all positions then all normals
+	const size_t num_faces = _faceList.getSize();
+	_faceSlots.reset(num_faces, num_faces);
+	std::vector<Vector3D> face_data(2*3*num_faces);
+	Vector3D * pos = face_data.data();
+	Vector3D * norm = pos + 3*num_faces;
+	int slot = 0;
 	for(Face * f = _faceList.getFirst(); f != nullptr; f = f->getNext()){
-		for(int fi =0; fi < 3; fi++){
-			// search for this face inside vertex face list
-			std::set<Face*> faces;
-			f->v[fi]->getFaces(faces);
-			int j = 0;
-			for(Face * fj : faces){
-				if(fj == f){
-					break;
-				}
-				j++;
-			}
-			indices[index_count] = f->v[fi]->id + j + 1;
-			index_count++;
+		f->slot = slot;
+		f->calculateNormal();
+		for(int i = 0; i < 3; i++){
+			pos[3*slot + i] = f->v[i]->position;
+			norm[3*slot + i] = f->normal;
 		}
+		slot++;
 	}
+	face_mesh.set3D((float*)face_data.data(), 3*num_faces, Mesh::NORMAL, GL_TRIANGLES);
 
-	// put vertices and normals into a single buffer with first verts and then normals 
-	unsigned int v_size = verts.size();
-	Vector3D * vert_norms = new Vector3D[v_size*2];
-	for(unsigned int i = 0; i < v_size; i++){
-		vert_norms[0      + i] = verts[i].v;
-		vert_norms[v_size + i] = verts[i].n;
+	// edge mesh: 2 vertices per slot, only positions
+	const size_t num_edges = _edgeList.getSize();
+	_edgeSlots.reset(num_edges, num_edges);
+	std::vector<Vector3D> edge_data(2*num_edges);
+	slot = 0;
+	for(Edge * e = _edgeList.getFirst(); e != nullptr; e = e->getNext()){
+		e->slot = slot;
+		edge_data[2*slot + 0] = e->v[0]->position;
+		edge_data[2*slot + 1] = e->v[1]->position;
+		slot++;
 	}
+	edge_mesh.set3D((float*)edge_data.data(), 2*num_edges, Mesh::ONLY_POSITION, GL_LINES);
 
-	// set new verticies in mesh
-	face_mesh.set3DIndexed(
-		(float*)vert_norms, v_size,
-		indices, num_indices,
-		Mesh::NORMAL, GL_TRIANGLES);
-	delete[] indices;
+	clearChanges();
+	_trackChanges = true;
+	_slotLayout = true;
+}
 
+void DynamicMesh::uploadChanges(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh)
+{
+	if(!_trackChanges || !_slotLayout){
+		uploadSlots(face_mesh, edge_mesh);
+		return;
+	}
 
-	// edge mesh
-	const size_t num_edge_indices = 2*_edgeList.getSize();
-	unsigned int * edge_indices = new unsigned int[num_edge_indices];
-	int edge_count = 0;
-	for(Edge * e = _edgeList.getFirst(); e != nullptr; e = e->getNext()){
-		edge_indices[edge_count] = e->v[0]->id;	
-		edge_count++;
-		edge_indices[edge_count] = e->v[1]->id;	
-		edge_count++;
+	// free slots of removed elements, then assign slots to new elements
+	for(int s : _releasedFaceSlots){
+		_faceSlots.free(s);
+	}
+	for(int s : _releasedEdgeSlots){
+		_edgeSlots.free(s);
+	}
+	for(Face * f : _changedFaces){
+		if(f->slot < 0){
+			f->slot = _faceSlots.allocate();
+		}
+	}
+	for(Edge * e : _changedEdges){
+		if(e->slot < 0){
+			e->slot = _edgeSlots.allocate();
+		}
 	}
 
-	edge_mesh.set3DIndexed(
-		(float*)vert_norms, v_size,
-		edge_indices,
-		num_edge_indices,
-		Mesh::ONLY_POSITION, GL_LINES);
+	// rebuild everything if buffers are too small or mostly filled with unused slots (they are still drawn)
+	if(	(size_t)face_mesh.getVertexCount() != 3*_faceSlots.getCapacity() ||
+		(size_t)edge_mesh.getVertexCount() != 2*_edgeSlots.getCapacity() ||
+		_faceSlots.getUsed()*4 < _faceSlots.getCapacity() ||
+		_edgeSlots.getUsed()*4 < _edgeSlots.getCapacity()){
+		uploadSlots(face_mesh, edge_mesh);
+		return;
+	}
+
+	// clear slots of removed elements (degenerated to a single point they are not rasterized)
+	const Vector3D zero_data[6];
+	for(int s : _releasedFaceSlots){
+		face_mesh.update3D((float*)zero_data, 3*s, 3);
+	}
+	for(int s : _releasedEdgeSlots){
+		edge_mesh.update3D((float*)zero_data, 2*s, 2);
+	}
+
+	// rewrite changed elements
+	Vector3D data[6];
+	bool in_range = true;
+	for(Face * f : _changedFaces){
+		f->calculateNormal();
+		for(int i = 0; i < 3; i++){
+			data[i] = f->v[i]->position;
+			data[3+i] = f->normal;
+		}
+		in_range &= face_mesh.update3D((float*)data, 3*f->slot, 3);
+	}
+	for(Edge * e : _changedEdges){
+		data[0] = e->v[0]->position;
+		data[1] = e->v[1]->position;
+		in_range &= edge_mesh.update3D((float*)data, 2*e->slot, 2);
+	}
+
+	// quantized mesh: a vertex moved outside the bounding box the buffer was quantized with
+	if(!in_range){
+		uploadSlots(face_mesh, edge_mesh);
+		return;
+	}
+
+	clearChanges();
+}
+
+void DynamicMesh::releaseSlot(Face * f)
+{
+	if(!_trackChanges){
+		return;
+	}
+	_changedFaces.erase(f);
+	if(f->slot >= 0){
+		_releasedFaceSlots.push_back(f->slot);
+		f->slot = -1;
+	}
+}
+
+void DynamicMesh::releaseSlot(Edge * e)
+{
+	if(!_trackChanges){
+		return;
+	}
+	_changedEdges.erase(e);
+	if(e->slot >= 0){
+		_releasedEdgeSlots.push_back(e->slot);
+		e->slot = -1;
+	}
+}
+
+void DynamicMesh::markChanged(Vertex * v)
+{
+	if(!_trackChanges){
+		return;
+	}
+	_changedVertices.insert(v);
+	for(Edge * e : v->edges){
+		_changedEdges.insert(e);
+		_changedFaces.insert(e->faces.begin(), e->faces.end());
+	}
+}
+
+void DynamicMesh::markRemoved(Vertex * v)
+{
+	if(!_trackChanges){
+		return;
+	}
+	_changedVertices.erase(v);
+	_removedVertices.push_back(v);
+}
 
-	delete[] edge_indices;
-	delete[] vert_norms;
+void DynamicMesh::clearChanges()
+{
+	_changedFaces.clear();
+	_changedEdges.clear();
+	_releasedFaceSlots.clear();
+	_releasedEdgeSlots.clear();
+	_changedVertices.clear();
+	_removedVertices.clear();
 }
 
 void DynamicMesh::integrity_check()
 {
-	INFO("Checking mesh integrity...");
+	VERBOSE("Checking mesh integrity...");
 	// check vertex connections
 	for(const Vertex * v = _vertexList.getFirst(); v != nullptr; v = v->getNext()){
 		for(Edge * e : v->edges){
@@ -359,7 +554,7 @@ void DynamicMesh::integrity_check()
 		}
 	}
 
-	INFO("-> OK.");
+	VERBOSE("-> OK.");
 }
 
 void DynamicMesh::edgeCollapse(Edge * e, const zer0::Vector3D& new_position, Vertex ** new_vertex, std::vector<Edge*> * removed_edges)
@@ -425,6 +620,7 @@ void DynamicMesh::edgeCollapse(Edge * e, const zer0::Vector3D& new_position, Ver
 				// remove all faces in marked list
 				for(Face * f : faces_to_be_removed){
 					f->removeThisFromEdges();
+					releaseSlot(f);
 					_faceList.remove(f);
 				}
 				faces_to_be_removed.clear();
@@ -440,6 +636,7 @@ void DynamicMesh::edgeCollapse(Edge * e, const zer0::Vector3D& new_position, Ver
 	for(Edge * e_i : edges_to_be_removed){
 		e_i->getOtherVertex(v1)->edges.erase(e_i);
 		v1->edges.erase(e_i);
+		releaseSlot(e_i);
 		// store removed edges pointers
 		if(removed_edges != nullptr){
 			removed_edges->push_back(e_i);
@@ -469,10 +666,15 @@ void DynamicMesh::edgeCollapse(Edge * e, const zer0::Vector3D& new_position, Ver
 	}
 
 	// delete v1
+	markRemoved(v1);
 	_vertexList.remove(v1);
 	
 	// delete collapsed edge
+	releaseSlot(e);
 	_edgeList.remove(e);
+
+	// all faces and edges around the merged vertex have moved
+	markChanged(v0);
 }
 
 void DynamicMesh::Edge::upload(zer0::Mesh & m)const
@@ -547,17 +749,19 @@ void DynamicMesh::initSQEM()
 void DynamicMesh::sphereApproximation(int num_spheres)
 {
 	while(_vertexList.getSize() > num_spheres){
-		sphereApproximationStep();
+		if(!sphereApproximationStep()){
+			break;
+		}
 	}
 }
 
-void DynamicMesh::sphereApproximationStep()
+bool DynamicMesh::sphereApproximationStep()
 {
 	// assume initSQEM() has been called at this point
 	/////
 	if(_collapseList.empty()){
 		INFO("No more edges to collapse.");
-		return;
+		return false;
 	}
 
 	// take next best collapse candidate
@@ -595,6 +799,12 @@ void DynamicMesh::sphereApproximationStep()
 		Edge * updated_edge = new Edge(e);
 		updated_edge->v[0]->edges.insert(updated_edge);
 		updated_edge->v[1]->edges.insert(updated_edge);
+		if(_trackChanges){// updated edge takes over the slot of the old one
+			updated_edge->slot = e->slot;
+			e->slot = -1;
+			_changedEdges.erase(e);
+			_changedEdges.insert(updated_edge);
+		}
 		_edgeList.add(updated_edge);
 		updated_edge->updateSQEM();
 		_collapseList.push(updated_edge);
@@ -612,4 +822,37 @@ void DynamicMesh::sphereApproximationStep()
 			collapsing_edge = nullptr;
 		}
 	}
+	return true;
+}
+
+bool DynamicMesh::saveSphereMesh(const char * filename)
+{
+	FILE * f = fopen(filename, "w");
+	if(f == NULL){
+		ERROR("Unable to open file '%s' for writing.", filename);
+		return false;
+	}
+
+	fprintf(f,	"# sphere mesh\n"
+				"# s <x> <y> <z> <radius>\n"
+				"# e <sphere index> <sphere index>\n"
+				"# f <sphere index> <sphere index> <sphere index>\n");
+	size_t count = 0;
+	for(Vertex * v = _vertexList.getFirst(); v != nullptr; v = v->getNext()){
+		v->id = count++;
+		fprintf(f, "s %f %f %f %f\n", v->position.x, v->position.y, v->position.z, v->sphere_radius);
+	}
+	for(const Edge * e = _edgeList.getFirst(); e != nullptr; e = e->getNext()){
+		fprintf(f, "e %lu %lu\n", e->v[0]->id, e->v[1]->id);
+	}
+	for(const Face * face = _faceList.getFirst(); face != nullptr; face = face->getNext()){
+		fprintf(f, "f %lu %lu %lu\n", face->v[0]->id, face->v[1]->id, face->v[2]->id);
+	}
+
+	bool success = !ferror(f);
+	fclose(f);
+	if(!success){
+		ERROR("While writing file '%s'.", filename);
+	}
+	return success;
 }
@@ -4,6 +4,7 @@
 #define DYNAMIC_MESH_H
 
 #include "zer0engine/zMesh.h"
+#include "zer0engine/zSlotAllocator.h"
 #include <vector>
 #include <set>
 #include <assert.h>
@@ -24,14 +25,6 @@ public:
 	struct Face;
 	struct CollapseCostCompare;
 
-	/* vector and normal convinience structure */
-	struct VN{
-		VN(){}
-		VN(const zer0::Vector3D & _v, const zer0::Vector3D & _n): v(_v), n(_n){}
-		zer0::Vector3D v;
-		zer0::Vector3D n;
-	};
-
 	/* type of priority queue
 	 * NOTE: we do not use a std::prio_queue here because removal of arbitrary elements is not possible
 	 *  we have to live with the fact that inserting in order now takes O(n) time
@@ -77,7 +70,7 @@ public:
 	 */
 	struct Face : public BackReferenceList<Face>::Item
 	{
-		Face(Vertex * _v0, Vertex * _v1, Vertex * _v2):v{_v0, _v1, _v2}{calculateNormal();}
+		Face(Vertex * _v0, Vertex * _v1, Vertex * _v2):v{_v0, _v1, _v2}, slot(-1){calculateNormal();}
 		~Face()override{}
 		Vertex * v[3];
 		zer0::Vector3D normal;
@@ -136,6 +129,7 @@ public:
 		}
 
 		SQEM Q;
+		int slot; // slot in face mesh (see uploadSlots()), -1 if not assigned
 	};
 
 	/**
@@ -143,8 +137,8 @@ public:
 	 */
 	struct Edge : public BackReferenceList<Edge>::Item
 	{
-		Edge(Vertex * _v0, Vertex * _v1): v{_v0, _v1}, needs_removal(false) {}
-		Edge(const Edge * e): v{e->v[0], e->v[1]}, needs_removal(false){ faces = e->faces; assert(faces.size() == e->faces.size());}
+		Edge(Vertex * _v0, Vertex * _v1): v{_v0, _v1}, needs_removal(false), slot(-1) {}
+		Edge(const Edge * e): v{e->v[0], e->v[1]}, needs_removal(false), slot(-1){ faces = e->faces; assert(faces.size() == e->faces.size());}
 		~Edge()override{}
 		Vertex* v[2]; // two verticies form an edge
 		
@@ -203,6 +197,7 @@ public:
 		}
 
 		bool needs_removal;// set to true if this edge should be deleted
+		int slot; // slot in edge mesh (see uploadSlots()), -1 if not assigned
 	}; // struct Edge
 
 	struct CollapseCostCompare{
@@ -229,10 +224,43 @@ public:
 	 */
 	void set(const std::vector<zer0::Vector3D> & verticies, const std::vector<unsigned int>& indicies);
 	
+	/* vertex layout for upload() */
+	enum UploadMode{
+		FLAT_NORMALS, // every vertex is stored once per adjacent face with the face normal and once with the averaged normal (used by edges)
+		SHARED_VERTICES // every vertex is stored once with the averaged normal
+	};
+
 	/**
 	 * upload vertex data to regular mesh, so it can be rendered
+	 * In both modes edge_mesh draws from the vertex buffer of face_mesh, so it must not be used after face_mesh changed (see Mesh::setShared()).
+	 * SHARED_VERTICES uploads about 1/7 of the data of FLAT_NORMALS, flat shading has to be done in the shader (see DiffuseShader::setFlatShading()).
+	 * Tracked changes are reset in both modes, the next call to uploadChanges() replaces the meshes with slots again.
+	 * Runs in linear time of the number of faces.
+	 */
+	void upload(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh, UploadMode mode = FLAT_NORMALS);
+
+	/**
+	 * upload faces (3 flat shaded vertices per face) and edges (2 vertices per edge) so they can be updated incrementally
+	 * Every face/edge is assigned a fixed slot in the vertex buffers. From now on the mesh keeps track of the faces and edges
+	 * changed by edge collapses, so uploadChanges() only has to rewrite those slots.
+	 * NOTE: the slot assignment belongs to the given meshes, do not pass other meshes to uploadChanges()
+	 */
+	void uploadSlots(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh);
+
+	/**
+	 * rewrite slots of faces/edges that changed since last call to uploadSlots()/uploadChanges(), slots of removed elements are cleared
+	 * Falls back to uploadSlots() if nothing was uploaded yet, the buffers have to grow or most of the buffers would be unused.
 	 */
-	void upload(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh);
+	void uploadChanges(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh);
+
+	/**
+	 * vertices that were moved (or got a new sphere radius) and vertices that were removed since the last call to
+	 * uploadSlots()/uploadChanges(), only tracked after uploadSlots() was called (see isTrackingChanges())
+	 * NOTE: removed vertices have already been freed, the pointers may only be used for identification
+	 */
+	const std::set<Vertex*>& getChangedVertices()const{return _changedVertices;}
+	const std::vector<const Vertex*>& getRemovedVertices()const{return _removedVertices;}
+	bool isTrackingChanges()const{return _trackChanges;}
 
 	void getEdgeMesh(zer0::Mesh & m, const Edge * e)const;
 	void getFaceMesh(zer0::Mesh & m, const Face * f)const;
@@ -274,8 +302,17 @@ public:
 	/*
 	 * perform a single step for sphere approximation
 	 * NOTE: initSQEM() has to be called first
+	 * @return false if there was no edge left to collapse
 	 */
-	void sphereApproximationStep();
+	bool sphereApproximationStep();
+
+	/*
+	 * write spheres (vertices), edges and faces to a text file
+	 * format: one element per line 's <x> <y> <z> <radius>', 'e <sphere> <sphere>', 'f <sphere> <sphere> <sphere>'
+	 * sphere indices start from 0
+	 * @return false on error, true on success
+	 */
+	bool saveSphereMesh(const char * filename);
 
 	void debug_print();
 
@@ -291,12 +328,34 @@ public:
 
 	const zer0::Vector3D& getCenterPos(){return _centerPos;}
 private:
+	/* change tracking for uploadChanges() */
+	void releaseSlot(Face * f); // called before face is removed
+	void releaseSlot(Edge * e); // called before edge is removed
+	void markChanged(Vertex * v); // mark v and all faces and edges connected to it as changed
+	void markRemoved(Vertex * v); // called before vertex is removed
+	void clearChanges();
+
+	/* upload() with SHARED_VERTICES */
+	void uploadShared(zer0::Mesh & face_mesh, zer0::Mesh & edge_mesh);
+
 	BackReferenceList<Vertex> _vertexList;
 	BackReferenceList<Face> _faceList;
 	BackReferenceList<Edge> _edgeList;
 
 	CollapseListType _collapseList; // edge collapses to be considered for mesh approximation, sorted by cost
 	zer0::Vector3D _centerPos;// center of bounding box around model
+
+	/* slot based upload */
+	bool _trackChanges; // set once uploadSlots() was called
+	bool _slotLayout; // meshes were last set by uploadSlots(), upload() replaces the slot layout
+	zer0::SlotAllocator _faceSlots;
+	zer0::SlotAllocator _edgeSlots;
+	std::set<Face*> _changedFaces;
+	std::set<Edge*> _changedEdges;
+	std::vector<int> _releasedFaceSlots;
+	std::vector<int> _releasedEdgeSlots;
+	std::set<Vertex*> _changedVertices;
+	std::vector<const Vertex*> _removedVertices;
 };
 
 #endif
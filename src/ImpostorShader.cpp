@@ -0,0 +1,141 @@
+#include "ImpostorShader.h"
+
+/* everything is calculated in view space, so the ray starts at the origin */
+static const char * SPHERE_VERTEX_SOURCE =
+"#version 120\n"
+ZER0_SHADER_CAMERA_UNIFORMS
+"attribute vec3 vertex;\n"
+"attribute vec4 color;\n"
+"attribute vec4 instance;\n"
+"varying vec4 out_color;\n"
+"varying vec3 view_pos;\n"
+"varying vec4 sphere;\n"
+"uniform mat4 modelMat;\n"
+"void main()\n"
+"{\n"
+"	mat4 mv = viewMat * modelMat;\n"
+"	float scale = length(mv[0].xyz);\n"
+"	sphere = vec4((mv * vec4(instance.xyz, 1)).xyz, instance.w*scale);\n"
+"	view_pos = (mv * vec4(instance.xyz + vertex*instance.w, 1)).xyz;\n"
+"	gl_Position = projMat * vec4(view_pos, 1);\n"
+"	out_color = color;\n"
+"}\n"
+;
+
+static const char * SPHERE_FRAGMENT_SOURCE =
+"#version 120\n"
+ZER0_SHADER_CAMERA_UNIFORMS
+"varying vec4 out_color;\n"
+"varying vec3 view_pos;\n"
+"varying vec4 sphere;\n"
+"void main()\n"
+"{\n"
+"	vec3 rd = normalize(view_pos);\n"
+"	float b = dot(sphere.xyz, rd);\n"
+"	float h = b*b - dot(sphere.xyz, sphere.xyz) + sphere.w*sphere.w;\n"
+"	if(h < 0.0){discard;}\n"
+"	float t = b - sqrt(h);\n"
+"	if(t < 0.0){discard;}\n"
+"	vec3 p = rd*t;\n"
+"	vec3 n = (p - sphere.xyz)/sphere.w;\n"
+"	vec4 clip = projMat * vec4(p, 1);\n"
+"	gl_FragDepth = 0.5*(clip.z/clip.w) + 0.5;\n"
+"	gl_FragColor = vec4(out_color.rgb*abs(n.z), out_color.a);\n"
+"}\n"
+;
+
+/* box is stretched from start (z=-1) to end (z=1) of the cone */
+static const char * CONE_VERTEX_SOURCE =
+"#version 120\n"
+ZER0_SHADER_CAMERA_UNIFORMS
+"attribute vec3 vertex;\n"
+"attribute vec4 color;\n"
+"attribute vec4 instance;\n"
+"attribute vec4 instance_end;\n"
+"varying vec4 out_color;\n"
+"varying vec3 view_pos;\n"
+"varying vec4 cone_start;\n"
+"varying vec4 cone_end;\n"
+"uniform mat4 modelMat;\n"
+"void main()\n"
+"{\n"
+"	mat4 mv = viewMat * modelMat;\n"
+"	float scale = length(mv[0].xyz);\n"
+"	vec3 axis = instance_end.xyz - instance.xyz;\n"
+"	vec3 dir = normalize(axis);\n"
+"	vec3 u = normalize(cross(dir, abs(dir.x) < 0.9 ? vec3(1, 0, 0) : vec3(0, 1, 0)));\n"
+"	vec3 v = cross(dir, u);\n"
+"	float r = max(instance.w, instance_end.w);\n"
+"	vec3 p = instance.xyz + axis*(vertex.z*0.5 + 0.5) + (u*vertex.x + v*vertex.y)*r;\n"
+"	cone_start = vec4((mv * vec4(instance.xyz, 1)).xyz, instance.w*scale);\n"
+"	cone_end = vec4((mv * vec4(instance_end.xyz, 1)).xyz, instance_end.w*scale);\n"
+"	view_pos = (mv * vec4(p, 1)).xyz;\n"
+"	gl_Position = projMat * vec4(view_pos, 1);\n"
+"	out_color = color;\n"
+"}\n"
+;
+
+/* intersection with the side of the cone, caps are covered by the spheres
+ * a point p lies on the cone if its distance to the axis equals the linearly interpolated radius,
+ * squaring both sides leads to a quadratic equation in ray parameter t
+ */
+static const char * CONE_FRAGMENT_SOURCE =
+"#version 120\n"
+ZER0_SHADER_CAMERA_UNIFORMS
+"varying vec4 out_color;\n"
+"varying vec3 view_pos;\n"
+"varying vec4 cone_start;\n"
+"varying vec4 cone_end;\n"
+"void main()\n"
+"{\n"
+"	vec3 rd = normalize(view_pos);\n"
+"	vec3 ba = cone_end.xyz - cone_start.xyz;\n"
+"	vec3 oa = -cone_start.xyz;\n"
+"	float ra = cone_start.w;\n"
+"	float rr = cone_start.w - cone_end.w;\n"
+"	float m0 = dot(ba, ba);\n"
+"	float m1 = dot(oa, ba);\n"
+"	float m2 = dot(rd, ba);\n"
+"	float m3 = dot(rd, oa);\n"
+"	float m5 = dot(oa, oa);\n"
+"	float hy = m0 + rr*rr;\n"
+"	float k2 = m0*m0 - m2*m2*hy;\n"
+"	float k1 = m0*m0*m3 - m1*m2*hy + m0*ra*rr*m2;\n"
+"	float k0 = m0*m0*m5 - m1*m1*hy + m0*ra*(2.0*rr*m1 - m0*ra);\n"
+"	float h = k1*k1 - k2*k0;\n"
+"	if(h < 0.0){discard;}\n"
+"	float t = (-k1 - sqrt(h))/k2;\n"
+"	float y = m1 + t*m2;\n"
+"	if(t < 0.0 || y < 0.0 || y > m0){discard;}\n"
+"	vec3 n = normalize(m0*(m0*(oa + t*rd) + rr*ra*ba) - ba*hy*y);\n"
+"	vec4 clip = projMat * vec4(rd*t, 1);\n"
+"	gl_FragDepth = 0.5*(clip.z/clip.w) + 0.5;\n"
+"	gl_FragColor = vec4(out_color.rgb*abs(n.z), out_color.a);\n"
+"}\n"
+;
+
+bool ImpostorShader::init()
+{
+	bool r;
+	if(_type == SPHERE){
+		r = load(SPHERE_VERTEX_SOURCE, SPHERE_FRAGMENT_SOURCE);
+	}
+	else{
+		r = load(CONE_VERTEX_SOURCE, CONE_FRAGMENT_SOURCE);
+	}
+	if(!r){
+		return false;
+	}
+
+	setVertexLocation("vertex");
+	setColorLocation("color");
+	setInstanceLocation("instance");
+	setModelMatrixLocation("modelMat");
+	setViewMatrixLocation("viewMat");
+	setProjectionMatrixLocation("projMat");
+	if(_type == CONE){
+		_instanceEndLoc = getLocation("instance_end", false);
+	}
+
+	return r;
+}
@@ -0,0 +1,51 @@
+#ifndef IMPOSTOR_SHADER_H
+#define IMPOSTOR_SHADER_H
+
+#include "zer0engine/zShader.h"
+
+/*
+ * Ray-casting shader for drawing exact spheres and cones (truncated, between two spheres) from a proxy box.
+ * The box (see Mesh::BOX with dimension 2) is instanced once per primitive, the fragment shader intersects
+ * the view ray with the quadric, discards missed fragments and writes the depth of the hit point.
+ * Shading matches DiffuseShader::MATCAP.
+ * Per-instance attributes:
+ *  SPHERE: instance = (center, radius)
+ *  CONE:   instance = (start, radius at start), instance_end = (end, radius at end)
+ * NOTE: requires OpenGL 3.3 (CONFIG.SUPPORTS_NEW_GL), view and model matrix must not contain non-uniform scaling
+ */
+class ImpostorShader : public zer0::Shader
+{
+public:
+	enum Type{SPHERE, CONE};
+
+	ImpostorShader(Type type):
+		Shader(type == SPHERE ? "Sphere-Impostor-Shader" : "Cone-Impostor-Shader"),
+		_type(type),
+		_instanceEndLoc(-1){}
+
+	bool init();
+
+	Type getType()const{return _type;}
+
+	/*
+	 * set pointer to cone end points (CONE only), see Shader::setInstancePointer()
+	 */
+	void setInstanceEndPointer(GLsizei stride = 0, size_t offset = 0){
+		invalidateColor(_instanceEndLoc);
+		glEnableVertexAttribArray(_instanceEndLoc);
+		glVertexAttribPointer(_instanceEndLoc, 4, GL_FLOAT, GL_FALSE, stride, (const void*)offset);
+		glVertexAttribDivisor(_instanceEndLoc, 1);
+	}
+
+	void disableInstanceEndArray(){
+		if(_instanceEndLoc < 0)return;
+		glDisableVertexAttribArray(_instanceEndLoc);
+		glVertexAttribDivisor(_instanceEndLoc, 0);
+	}
+
+private:
+	Type _type;
+	GLint _instanceEndLoc;
+};
+
+#endif
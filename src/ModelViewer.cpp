@@ -16,9 +16,11 @@
 #define TRIANGLE_COLOR          0xa0a0efFF
 #define MIN_CYLINDER_RADIUS     0.001
 #define LINE_WIDTH              1
-#define NUM_SEGMENTS            64    /* number of segments (aka smoothness) used for rendering spheres and cylinders in sphere mesh */
+#define NUM_SEGMENTS            64    /* max. number of segments (aka smoothness) used for rendering spheres and cylinders in sphere mesh, reduced for small primitives on screen */
 #define KEY_MODE_SWITCH         SDLK_a
 #define KEY_SPHERE_MODE_SWITCH  SDLK_d
+#define KEY_CANCEL              SDLK_c  /* stop running approximation and keep current result */
+#define KEY_IMPOSTOR_SWITCH     SDLK_i  /* toggle ray-casted impostors for spheres and cylinders */
 #define SEPARATOR_LINE_WIDTH    2
 #define SEPARATOR_LINE_COLOR    0x202020FF 
 /*****************/
@@ -32,13 +34,21 @@ ModelViewer::ModelViewer():
 	_separatorLineColor(SEPARATOR_LINE_COLOR),
 	_meshDrawMode(FILL, NUM_DRAW_MODES),
 	_sphereDrawMode(SAME_COLOR, NUM_SPHERE_DRAW_MODES),
-	_sphereMesh(SPHERE_RADIUS_OFFSET)
+	_sphereImpostorShader(ImpostorShader::SPHERE),
+	_coneImpostorShader(ImpostorShader::CONE),
+	_impostorsAvailable(false),
+	_useImpostors(false),
+	_sphereMesh(SPHERE_RADIUS_OFFSET),
+	_approximationRunning(false),
+	_approximationCanceled(false),
+	_snapshotReady(false),
+	_snapshotWaiting(false),
+	_approximationStartTime(0)
 {
 }
 
-bool ModelViewer::init(const std::string & model_file, int num_spheres)
+void ModelViewer::initRendering()
 {
-	_modelFilename = model_file;
 	// opengl configuration
 	Color bg_color(BACKGROUND_COLOR);
 	glClearColor(bg_color.r, bg_color.g, bg_color.b, bg_color.a);
@@ -50,9 +60,30 @@ bool ModelViewer::init(const std::string & model_file, int num_spheres)
 	_meshShader.use();
 	_meshShader.setLightDir(Vector3D(1.0, 1.5, 1.3).getNormalized());
 
+	// impostor shaders are optional
+	if(SphereMesh::supportsImpostors()){
+		INFO("-> Compiling Impostor Shaders");
+		_impostorsAvailable = _sphereImpostorShader.init() && _coneImpostorShader.init();
+	}
+
+	// meshes that are re-uploaded while stepping through the approximation or selecting edges
+	_faceMesh.setUsage(GL_DYNAMIC_DRAW);
+	_faceMesh.setQuantization(true);
+	_edgeMesh.setUsage(GL_DYNAMIC_DRAW);
+	_selectedEdgeMesh.setUsage(GL_STREAM_DRAW);
+	_selectedEdgeFacesMesh.setUsage(GL_STREAM_DRAW);
+
 	// separator line
 	float line_data[4] = {0,1,  0,-1};
 	_separatorMesh.set2D(line_data, 2, Mesh::ONLY_POSITION, GL_LINES);
+	_originalMesh.setOptimizeOrder(true);
+	_originalMesh.setQuantization(true);
+}
+
+bool ModelViewer::init(const std::string & model_file, int num_spheres, int snapshot_interval)
+{
+	_modelFilename = model_file;
+	initRendering();
 
 	// loading obj
 	std::vector<Vector3D> vertex_data;
@@ -72,28 +103,7 @@ bool ModelViewer::init(const std::string & model_file, int num_spheres)
 	_modelCenterPosition = _dynamicMesh.getCenterPos();
 	_sphereMesh.setPosition(-_modelCenterPosition);
 
-	// initialize SQEM of each vertex
-	INFO("-> Initializing SQEM...");
-	Uint32 t = SDL_GetTicks();
-	_dynamicMesh.initSQEM();
-	Uint32 t2 = SDL_GetTicks();
-	INFO("   Done, took %.3f seconds\n", (t2-t)/1000.f);
-
-	// run full Approximation Algorithm
-	INFO("-> Running Sphere Mesh Approximation Algorithm (reducing to %d spheres) ...", num_spheres);
-	t = SDL_GetTicks();
-	_dynamicMesh.sphereApproximation(num_spheres);
-	INFO("   Done, took %.3f seconds.\n", (SDL_GetTicks()-t)/1000.f);
-
-	// create sphere mesh
-	INFO("-> Uploading mesh...");
-	t = SDL_GetTicks();
-	updateSphereMeshModel();
-	INFO("   Done, took %.3f seconds.\n", (SDL_GetTicks()-t)/1000.f);
-
-	printSphereMeshInfo();
-
-	// show window now that we are done (window was created with hidden flag)
+	// show window now that the model is loaded (window was created with hidden flag)
 	FW->showWindow();
 
 	// draw only on change
@@ -104,11 +114,105 @@ bool ModelViewer::init(const std::string & model_file, int num_spheres)
 
 	updateSphereMeshColors();
 
+	// run approximation in background, intermediate results are picked up in update()
+	_approximationRunning = true;
+	_approximationCanceled = false;
+	_approximationStartTime = SDL_GetTicks();
+	_approximationThread = std::thread(&ModelViewer::approximate, this, num_spheres, snapshot_interval);
+
 	return true;
 }
 
+bool ModelViewer::initPreview()
+{
+	initRendering();
+	FW->setViewportMode(Framework::VIEW_VSPLIT);
+	eventWindowResized(FW->getWindowW()/2, FW->getWindowH());
+	updateSphereMeshColors();
+	return true;
+}
+
+void ModelViewer::setPreview(const Mesh::OBJData & model, DynamicMesh & sphere_mesh)
+{
+	_originalMesh.setOBJ(model);
+	_modelCenterPosition = sphere_mesh.getCenterPos();
+	_sphereMesh.setPosition(-_modelCenterPosition);
+	_sphereMesh.init(sphere_mesh, NUM_SEGMENTS, MIN_SPHERE_RADIUS, MIN_CYLINDER_RADIUS);
+}
+
 ModelViewer::~ModelViewer()
 {
+	cancelApproximation();
+}
+
+void ModelViewer::approximate(int num_spheres, int snapshot_interval)
+{
+	// initialize SQEM of each vertex
+	INFO("-> Initializing SQEM...");
+	Uint32 t = SDL_GetTicks();
+	{
+		std::lock_guard<std::mutex> lock(_dynamicMeshMutex);
+		_dynamicMesh.initSQEM();
+	}
+	INFO("   Done, took %.3f seconds\n", (SDL_GetTicks()-t)/1000.f);
+
+	// run approximation algorithm, releasing the mesh after every snapshot_interval collapses
+	INFO("-> Running Sphere Mesh Approximation Algorithm (reducing to %d spheres) ...", num_spheres);
+	t = SDL_GetTicks();
+	bool done = false;
+	while(!done){
+		// let the main thread take the snapshot before continuing (waiting releases the mutex)
+		std::unique_lock<std::mutex> lock(_dynamicMeshMutex);
+		_snapshotTaken.wait(lock, [this]{return !_snapshotWaiting;});
+		for(int i = 0; !done && (snapshot_interval <= 0 || i < snapshot_interval); i++){
+			done =	_approximationCanceled ||
+					_dynamicMesh.getVertexList().getSize() <= (size_t)num_spheres ||
+					!_dynamicMesh.sphereApproximationStep();
+		}
+		// running flag has to be reset before signaling the final snapshot
+		_approximationRunning = !done;
+		_snapshotReady = true;
+		// main loop might be sleeping until the next event
+		FW->wakeUp();
+	}
+	if(_approximationCanceled){
+		INFO("   Canceled after %.3f seconds.\n", (SDL_GetTicks()-t)/1000.f);
+	}
+	else{
+		INFO("   Done, took %.3f seconds.\n", (SDL_GetTicks()-t)/1000.f);
+	}
+}
+
+void ModelViewer::updateSnapshot()
+{
+	if(!_snapshotReady){
+		return;
+	}
+	bool finished;
+	_snapshotWaiting = true;
+	{
+		std::lock_guard<std::mutex> lock(_dynamicMeshMutex);
+		_snapshotWaiting = false;
+		_snapshotReady = false;
+		// the approximation thread only changes the flag while holding the mutex, so it belongs to this snapshot
+		finished = !_approximationRunning;
+		updateSphereMeshModel(finished);
+	}
+	_snapshotTaken.notify_one();
+	if(finished){
+		_approximationThread.join();
+		INFO("-> Total time until final result: %.3f seconds.\n", (SDL_GetTicks()-_approximationStartTime)/1000.f);
+		printSphereMeshInfo();
+	}
+	FW->renderRequest();
+}
+
+void ModelViewer::cancelApproximation()
+{
+	if(_approximationThread.joinable()){
+		_approximationCanceled = true;
+		_approximationThread.join();
+	}
 }
 
 void ModelViewer::printSphereMeshInfo()
@@ -122,10 +226,30 @@ void ModelViewer::printSphereMeshInfo()
 		 _dynamicMesh.getFaceList().getSize());
 }
 
-void ModelViewer::updateSphereMeshModel()
+void ModelViewer::updateSphereMeshModel(bool compact)
 {
-	_dynamicMesh.upload(_faceMesh, _edgeMesh);
-	_sphereMesh.init(_dynamicMesh, NUM_SEGMENTS, MIN_SPHERE_RADIUS, MIN_CYLINDER_RADIUS);
+	// uploading resets the change tracking, so the changes are copied for the sphere mesh first
+	bool incremental = _dynamicMesh.isTrackingChanges() && _sphereMesh.isInitialized();
+	std::set<DynamicMesh::Vertex*> changed_vertices;
+	std::vector<const DynamicMesh::Vertex*> removed_vertices;
+	if(incremental){
+		changed_vertices = _dynamicMesh.getChangedVertices();
+		removed_vertices = _dynamicMesh.getRemovedVertices();
+	}
+	// snapshots and single steps only rewrite the slots of changed faces and edges,
+	// the final mesh is uploaded compact with every vertex shared by faces and edges (the next step starts over with slots)
+	if(compact){
+		_dynamicMesh.upload(_faceMesh, _edgeMesh, DynamicMesh::SHARED_VERTICES);
+	}
+	else{
+		_dynamicMesh.uploadChanges(_faceMesh, _edgeMesh);
+	}
+	if(incremental){
+		_sphereMesh.update(_dynamicMesh, changed_vertices, removed_vertices);
+	}
+	else{
+		_sphereMesh.init(_dynamicMesh, NUM_SEGMENTS, MIN_SPHERE_RADIUS, MIN_CYLINDER_RADIUS);
+	}
 }
 
 void ModelViewer::updateSphereMeshColors()
@@ -168,13 +292,30 @@ void ModelViewer::setModelCenterPosition()
 }
 
 void ModelViewer::drawSphereMesh(){
+	if(_useImpostors){// impostor shaders need the same camera as the mesh shader (already shared if they use the camera block)
+		if(!_sphereImpostorShader.usesCameraBlock()){
+			for(ImpostorShader * s : {&_sphereImpostorShader, &_coneImpostorShader}){
+				s->use();
+				s->setProjectionMatrix(_projectionMat);
+				_camera.upload();
+			}
+			_meshShader.use();
+		}
+	}
+	// cull primitives outside the view frustum and choose tessellation of spheres and cylinders from their size on screen
+	Matrix4 view;
+	_camera.getViewMatrix(view);
+	_sphereMesh.updateLOD(view, _projectionMat, FW->getWindowH());
 	_meshShader.setLightMode(DiffuseShader::MATCAP);
 	if(_sphereDrawMode == SKELETON){
-		_sphereMesh.drawSpheres();
+		drawSpheres(false);
 		SHADER->setColor(Color(MESH_FILL_COLOR));
 		setModelCenterPosition();
+		// vertex normals of slot uploads are face normals already, shared vertices are averaged (see DynamicMesh::upload())
+		_meshShader.setFlatShading(true);
 		_faceMesh.bind();
 		_faceMesh.draw();
+		_meshShader.setFlatShading(false);
 
 		_meshShader.setLightMode(DiffuseShader::UNSHADED);
 		SHADER->setColor(Color(MESH_LINE_COLOR));
@@ -182,7 +323,25 @@ void ModelViewer::drawSphereMesh(){
 		_edgeMesh.draw();
 	}
 	else{ // draw underlying skeleton + spheres
-		_sphereMesh.draw();
+		drawSpheres(true);
+		_sphereMesh.drawTriangles();
+	}
+}
+
+void ModelViewer::drawSpheres(bool cylinders)
+{
+	if(_useImpostors){
+		_sphereMesh.drawSphereImpostors(_sphereImpostorShader);
+		if(cylinders){
+			_sphereMesh.drawCylinderImpostors(_coneImpostorShader);
+		}
+		_meshShader.use();
+	}
+	else{
+		_sphereMesh.drawSpheres();
+		if(cylinders){
+			_sphereMesh.drawCylinders();
+		}
 	}
 }
 
@@ -249,9 +408,27 @@ void ModelViewer::eventKeyboard(SDL_Keycode key, bool pressed, int repeat)
 			updateSphereMeshColors();
 			FW->renderRequest();
 		}break;
-		case SDLK_SPACE:{
+		case KEY_IMPOSTOR_SWITCH:{
+			if(_impostorsAvailable){
+				_useImpostors = !_useImpostors;
+				INFO("Impostor rendering %s.", _useImpostors ? "enabled" : "disabled");
+				FW->renderRequest();
+			}
+			else{
+				WARNING("Impostor rendering is not available (requires OpenGL 3.3).");
+			}
+		}break;
+		case KEY_CANCEL:{
+			if(_approximationRunning){
+				_approximationCanceled = true;
+			}
+		}break;
+		case SDLK_SPACE:{// single step, only possible when approximation thread has finished
+			if(_approximationThread.joinable()){
+				break;
+			}
 			_dynamicMesh.sphereApproximationStep();
-			updateSphereMeshModel();
+			updateSphereMeshModel(false);
 			printSphereMeshInfo();
 			FW->renderRequest();
 		}break;
@@ -298,5 +475,6 @@ void ModelViewer::eventWindowResized(int new_width, int new_height)
 
 bool ModelViewer::update()
 {
+	updateSnapshot();
 	return true;
 }
@@ -5,9 +5,14 @@
 
 #include "zer0engine/zer0engine.h"
 #include "DiffuseShader.h"
+#include "ImpostorShader.h"
 #include "DynamicMesh.h"
 #include "SphereMesh.h"
 #include "ModeSwitcher.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 class ModelViewer : public zer0::Application
 {
@@ -15,8 +20,25 @@ public:
 	enum DrawMode{FILL, LINE, FILL_AND_LINE, NUM_DRAW_MODES};
 	enum SphereDrawMode{SAME_COLOR, DIFFERENT_COLOR, SKELETON, NUM_SPHERE_DRAW_MODES};
 
-	/* initialize */
-	bool init(const std::string & model_file, int num_spheres);
+	/*
+	 * initialize
+	 * the approximation runs on a background thread, the window is shown right after the model was loaded
+	 * @param snapshot_interval number of edge collapses between two intermediate results displayed, 0 to only display the final result
+	 */
+	bool init(const std::string & model_file, int num_spheres, int snapshot_interval);
+
+	/*
+	 * initialize for rendering previews of finished approximations (see setPreview()), e.g. offscreen with Framework::renderFrame()
+	 * no model is loaded and no approximation thread is started
+	 */
+	bool initPreview();
+
+	/*
+	 * show given model in the left viewport and its approximation in the right viewport
+	 * @param model parsed model including normals (see Mesh::parseOBJ())
+	 * @param sphere_mesh approximation of the model, not modified
+	 */
+	void setPreview(const zer0::Mesh::OBJData & model, DynamicMesh & sphere_mesh);
 
 	ModelViewer();
 	~ModelViewer();
@@ -28,15 +50,26 @@ public:
 	void eventWindowResized(int new_width, int new_height)override;
 
 private:
+	void initRendering(); // shaders, gl state and meshes used by init() and initPreview()
 	void drawSeparator(); // draw line dividing left/right view
 	void drawMesh();
 	void drawSphereMesh();
+	void drawSpheres(bool cylinders); // draw spheres (and cylinders) of sphere mesh as impostors or meshes
 	void selectEdge(DynamicMesh::Edge * e);
-	void updateSphereMeshModel();
+	void updateSphereMeshModel(bool compact); // upload changes of dynamic mesh, compact: shared vertex layout instead of incremental slots
 	void printSphereMeshInfo();
 	void setModelCenterPosition(); // set model matrix in shader
 	void updateSphereMeshColors();
 
+	/* main function of approximation thread */
+	void approximate(int num_spheres, int snapshot_interval);
+
+	/* upload current state of dynamic mesh if approximation thread signaled a new snapshot, called from main thread */
+	void updateSnapshot();
+
+	/* stop approximation thread as soon as possible and wait for it to finish */
+	void cancelApproximation();
+
 	zer0::Mesh _originalMesh;
 	zer0::Mesh _faceMesh;
 	zer0::Mesh _edgeMesh;
@@ -55,9 +88,23 @@ private:
 	ModeSwitcher<DrawMode>       _meshDrawMode;
 	ModeSwitcher<SphereDrawMode> _sphereDrawMode;
 	DiffuseShader _meshShader;
+	ImpostorShader _sphereImpostorShader;
+	ImpostorShader _coneImpostorShader;
+	bool _impostorsAvailable; // impostor shaders compiled successfully
+	bool _useImpostors;
 	zer0::Matrix4 _projectionMat;
 
 	zer0::Vector3D _modelCenterPosition;
+
+	/* background approximation */
+	std::thread _approximationThread;
+	std::mutex _dynamicMeshMutex;            // held by approximation thread while modifying _dynamicMesh
+	std::atomic<bool> _approximationRunning;
+	std::atomic<bool> _approximationCanceled;
+	std::atomic<bool> _snapshotReady;        // set by approximation thread, reset by main thread after uploading
+	std::atomic<bool> _snapshotWaiting;      // main thread is waiting for _dynamicMeshMutex
+	std::condition_variable _snapshotTaken;  // notified by main thread after uploading, approximation thread waits on it while _snapshotWaiting
+	Uint32 _approximationStartTime;
 };
 
 #endif
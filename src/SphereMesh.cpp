@@ -1,189 +1,695 @@
 #include "SphereMesh.h"
+#include <algorithm>
+#include "zer0engine/zParallel.h"
+#ifdef __SSE__
+	#include <xmmintrin.h>
+#endif
+
+/* minimum number of cylinders/faces generated by a single thread in init() */
+#define MIN_PRIMITIVES_PER_THREAD 256
 
 using namespace zer0;
 
 SphereMesh::SphereMesh(float sphere_radius_offset): _sphereColor(Color::WHITE), _cylinderColor(Color::WHITE), _triangleColor(Color::WHITE),
-							 _sphereRadiusOffset(sphere_radius_offset)
+							 _sphereRadiusOffset(sphere_radius_offset), _sphereInstanceBuffer(0),
+							 _coneInstanceBuffer(0), _numSegments(32), _minSphereRadius(0), _minCylinderRadius(0)
 {
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		_lodSegments[l] = 0;
+		_sphereLODCount[l] = 0;
+	}
+	_sphereLODCount[SPHERE_MESH_CULLED] = 0;
+}
+
+SphereMesh::~SphereMesh()
+{
+	clear();
 }
 
 void SphereMesh::clear()
 {
 	_spheres.clear();
-	_sphereMesh.clear();
-	_cylinderMeshes.clear();
+	_cylinders.clear();
+	_sphereLOD.clear();
+	_cylinderLOD.clear();
+	_vertexPrimitives.clear();
+	_sphereVertices.clear();
+	_cylinderVertices.clear();
+	_prismVertices.clear();
+	_sphereSlots.reset(0, 0);
+	_cylinderSlots.reset(0, 0);
+	_prismSlots.reset(0, 0);
+	_cylinderTemplates.clear();
+	glDeleteBuffers(1, &_sphereInstanceBuffer);
+	_sphereInstanceBuffer = 0;
+	glDeleteBuffers(1, &_coneInstanceBuffer);
+	_coneInstanceBuffer = 0;
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		_sphereMeshes[l].clear();
+		_cylinderMeshes[l].clear();
+		_cylinderRangeFirst[l].clear();
+		_cylinderRangeCount[l].clear();
+		_sphereLODCount[l] = 0;
+	}
+	_sphereLODCount[SPHERE_MESH_CULLED] = 0;
+	_prismBounds.clear();
+	_prismVisible.clear();
+	_prismRangeFirst.clear();
+	_prismRangeCount.clear();
 	_trianglesMesh.clear();
 }
 
 void SphereMesh::init(const DynamicMesh & m, int num_segments, float min_sphere_radius, float min_cylinder_radius)
 {
-	// creating single sphere
-	_sphereMesh.loadPrimitive(Mesh::SPHERE, Vector3D(2,2,2), num_segments);
+	_numSegments = num_segments;
+	_minSphereRadius = min_sphere_radius;
+	_minCylinderRadius = min_cylinder_radius;
+	// every level of detail halves the number of segments (but not below 8)
+	_cylinderTemplates.clear();
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		_lodSegments[l] = std::max(num_segments >> l, std::min(num_segments, 8));
+		_cylinderTemplates.push_back(CylinderTemplate(_lodSegments[l]));
+	}
+
+	// creating single sphere for every level
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		_sphereMeshes[l].loadPrimitive(Mesh::SPHERE, Vector3D(2,2,2), _lodSegments[l]);
+	}
 	const DynamicMesh::Vertex * vert_i = m.getVertexList().getFirst();
 	size_t num_verts = m.getVertexList().getSize();
-	_spheres.resize(num_verts);
-	int v_count = 0;
-	float min_dist = 1000;
+	_vertexPrimitives.clear();
+	_vertexPrimitives.reserve(num_verts);
+	_spheres.clear();
+	_sphereVertices.clear();
 	for(; vert_i != nullptr; vert_i = vert_i->getNext()){
+		VertexPrimitives & vp = _vertexPrimitives[vert_i];
 		if(vert_i->sphere_radius >= min_sphere_radius){
-			_spheres[v_count].set(vert_i->position, vert_i->sphere_radius);
-			v_count++;
+			vp.sphere = _spheres.size();
+			_spheres.push_back(Vector4D(vert_i->position, vert_i->sphere_radius));
+			_sphereVertices.push_back(vert_i);
 		}
 	}
-	_spheres.resize(v_count);
+	_sphereSlots.reset(_spheres.size(), _spheres.size());
+	_sphereLOD.assign(_spheres.size(), 0);
+	uploadSphereInstances();
 
 	int num_floats_per_vert = 6;
-	// creating multiple cylinder meshes
-	const DynamicMesh::Edge * edge_i = m.getEdgeList().getFirst();
-	size_t num_edges = m.getEdgeList().getSize();
-	_cylinderMeshes.resize(num_edges);
-	int vertex_count = (num_segments+1)*2;
-	float * vertex_data = new float[num_floats_per_vert*vertex_count];
-	int e_count = 0;
-	for(; edge_i != nullptr; edge_i = edge_i->getNext()){
-		float r1 = edge_i->v[0]->sphere_radius;
-		float r2 = edge_i->v[1]->sphere_radius;
-		if(r1 >= min_cylinder_radius || r2 >= min_cylinder_radius){
-			Vector3D start = edge_i->v[0]->position;
-			Vector3D end   = edge_i->v[1]->position;
-
-			// create local orthonormal coordinate system t0, t1, t2
-			Vector3D t0 = (end-start).getNormalized();
-			Vector2D off1, off2;
-			calculateSphereTangent(Vector4D(start, r1), Vector4D(end, r2), off1, off2);
-			start = start + t0*off1.x;
-			end = end + t0*off2.x;
-			r1 = off1.y;
-			r2 = off2.y;
-			float len = (start-end).getLength();
-			Vector3D t1, t2;
-			createOrthonormalBase(t0, t1, t2);
-
-			Vector3D * pos = (Vector3D*)vertex_data;
-			Vector3D * norm = (Vector3D*)(vertex_data+vertex_count*3);
-			int c = 0;
-			// create cylinder vertices
-			float r_delta = r2-r1;
-			float sin_alpha = r_delta/len;
-			for(int i = 0; i < num_segments; i++){
-				float angle = 2*M_PI*i/num_segments;
-				Vector3D circle_pos = cos(angle)*t1 + sin(angle)*t2;
-				Vector3D n = circle_pos*fabs(r_delta) - sin_alpha*t0*fabs(r_delta);
-				n.normalize();
-				pos[c] = end + r2*circle_pos;
-				norm[c] = n;
-				c++;
-				pos[c] = start + r1*circle_pos;
-				norm[c] = n;
-				c++;
+	// creating cylinders, all cylinders of one level of detail are stored in a single indexed mesh
+	std::vector<const DynamicMesh::Edge*> cylinder_edges;
+	cylinder_edges.reserve(m.getEdgeList().getSize());
+	_cylinderVertices.clear();
+	for(const DynamicMesh::Edge * edge_i = m.getEdgeList().getFirst(); edge_i != nullptr; edge_i = edge_i->getNext()){
+		if(edge_i->v[0]->sphere_radius >= min_cylinder_radius || edge_i->v[1]->sphere_radius >= min_cylinder_radius){
+			for(int i = 0; i < 2; i++){
+				_vertexPrimitives[edge_i->v[i]].cylinders.push_back(cylinder_edges.size());
+				_cylinderVertices.push_back(edge_i->v[i]);
+			}
+			cylinder_edges.push_back(edge_i);
+		}
+	}
+	const size_t num_cylinders = cylinder_edges.size();
+	_cylinderSlots.reset(num_cylinders, num_cylinders);
+	_cylinders.resize(2*num_cylinders);
+	_cylinderLOD.assign(num_cylinders, 0);
+	// staging buffers for all levels, every cylinder writes to its own slice
+	float * vertex_data[SPHERE_MESH_NUM_LODS];
+	unsigned int * index_data[SPHERE_MESH_NUM_LODS];
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		vertex_data[l] = new float[num_floats_per_vert*num_cylinders*_lodSegments[l]*2];
+		index_data[l] = new unsigned int[num_cylinders*_lodSegments[l]*6];
+	}
+	parallelFor(num_cylinders, MIN_PRIMITIVES_PER_THREAD, [&](size_t begin, size_t end){
+		for(size_t e_count = begin; e_count < end; e_count++){
+			const DynamicMesh::Edge * edge_i = cylinder_edges[e_count];
+			Vector4D & start = _cylinders[2*e_count + 0];
+			Vector4D & end = _cylinders[2*e_count + 1];
+			calculateCylinder(edge_i->v[0], edge_i->v[1], start, end);
+			for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+				const size_t vertex_count = _lodSegments[l]*2; // vertices per cylinder
+				const size_t index_count = _lodSegments[l]*6; // indices per cylinder (2 triangles per segment)
+				const size_t first_vertex = e_count*vertex_count;
+				generateCylinder(start, end, _cylinderTemplates[l],
+								((Vector3D*)vertex_data[l]) + first_vertex,
+								((Vector3D*)vertex_data[l]) + num_cylinders*vertex_count + first_vertex,
+								index_data[l] + e_count*index_count, first_vertex);
+			}
+		}
+	});
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		_cylinderMeshes[l].set3DIndexed(vertex_data[l], num_cylinders*_lodSegments[l]*2, index_data[l], num_cylinders*_lodSegments[l]*6, Mesh::NORMAL, GL_TRIANGLES);
+		delete[] vertex_data[l];
+		delete[] index_data[l];
+	}
+	updateCylinderRanges();
+	if(supportsImpostors()){
+		if(_coneInstanceBuffer == 0){
+			glGenBuffers(1, &_coneInstanceBuffer);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, _coneInstanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vector4D)*_cylinders.size(), _cylinders.data(), GL_STATIC_DRAW);
+		Mesh::countUpload(sizeof(Vector4D)*_cylinders.size(), true);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if(_proxyBox.getVertexCount() == 0){
+			_proxyBox.loadPrimitive(Mesh::BOX, Vector3D(2, 2, 2));
+		}
+	}
+
+	// creating triangle mesh, every face is turned into a prism independently
+	std::vector<const DynamicMesh::Face*> faces;
+	faces.reserve(m.getFaceList().getSize());
+	_prismVertices.clear();
+	for(const DynamicMesh::Face * face_i = m.getFaceList().getFirst(); face_i != nullptr; face_i = face_i->getNext()){
+		for(int i = 0; i < 3; i++){
+			_vertexPrimitives[face_i->v[i]].prisms.push_back(faces.size());
+			_prismVertices.push_back(face_i->v[i]);
+		}
+		faces.push_back(face_i);
+	}
+	const size_t num_faces = faces.size();
+	_prismSlots.reset(num_faces, num_faces);
+	float * face_data = new float[num_floats_per_vert*3*num_faces*2];
+	Vector3D * face_p = (Vector3D*)(face_data);
+	Vector3D * face_n = face_p + 3*num_faces*2;
+	_prismBounds.resize(num_faces);
+	parallelFor(num_faces, MIN_PRIMITIVES_PER_THREAD, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			generatePrism(faces[i], face_p + i*3*2, face_n + i*3*2);
+			_prismBounds[i] = getPrismBounds(faces[i]);
+		}
+	});
+	_trianglesMesh.set3D(face_data, 2*3*num_faces, Mesh::NORMAL, GL_TRIANGLES);
+	delete[] face_data;
+	_prismVisible.assign(num_faces, 1);
+	updatePrismRanges();
+}
+
+void SphereMesh::update(const DynamicMesh & m, const std::set<DynamicMesh::Vertex*> & changed,
+						const std::vector<const DynamicMesh::Vertex*> & removed)
+{
+	// free slots of everything connected to changed/removed vertices
+	std::vector<int> freed_spheres, freed_cylinders, freed_prisms;
+	for(const DynamicMesh::Vertex * v : removed){
+		releasePrimitives(v, freed_spheres, freed_cylinders, freed_prisms);
+		_vertexPrimitives.erase(v);
+	}
+	for(const DynamicMesh::Vertex * v : changed){
+		releasePrimitives(v, freed_spheres, freed_cylinders, freed_prisms);
+	}
+
+	// assign new slots to all primitives connected to changed vertices
+	std::vector<int> new_spheres;
+	std::vector<std::pair<int, const DynamicMesh::Edge*>> new_cylinders;
+	std::vector<std::pair<int, const DynamicMesh::Face*>> new_prisms;
+	std::set<const DynamicMesh::Edge*> visited_edges;
+	std::set<const DynamicMesh::Face*> visited_faces;
+	for(const DynamicMesh::Vertex * v : changed){
+		VertexPrimitives & vp = _vertexPrimitives[v];
+		if(v->sphere_radius >= _minSphereRadius){
+			vp.sphere = _sphereSlots.allocate();
+			if(vp.sphere >= (int)_sphereVertices.size()){
+				_sphereVertices.resize(_sphereSlots.getCapacity(), nullptr);
+			}
+			_sphereVertices[vp.sphere] = v;
+			new_spheres.push_back(vp.sphere);
+		}
+		for(const DynamicMesh::Edge * e : v->edges){
+			if(!visited_edges.insert(e).second){
+				continue;
+			}
+			if(e->v[0]->sphere_radius >= _minCylinderRadius || e->v[1]->sphere_radius >= _minCylinderRadius){
+				int c = _cylinderSlots.allocate();
+				if(2*c >= (int)_cylinderVertices.size()){
+					_cylinderVertices.resize(2*_cylinderSlots.getCapacity(), nullptr);
+				}
+				for(int i = 0; i < 2; i++){
+					_vertexPrimitives[e->v[i]].cylinders.push_back(c);
+					_cylinderVertices[2*c + i] = e->v[i];
+				}
+				new_cylinders.push_back(std::make_pair(c, e));
+			}
+			for(const DynamicMesh::Face * f : e->faces){
+				if(!visited_faces.insert(f).second){
+					continue;
+				}
+				int p = _prismSlots.allocate();
+				if(3*p >= (int)_prismVertices.size()){
+					_prismVertices.resize(3*_prismSlots.getCapacity(), nullptr);
+				}
+				for(int i = 0; i < 3; i++){
+					_vertexPrimitives[f->v[i]].prisms.push_back(p);
+					_prismVertices[3*p + i] = f->v[i];
+				}
+				new_prisms.push_back(std::make_pair(p, f));
+			}
+		}
+	}
+
+	// rebuild everything if buffers are too small or mostly filled with unused slots (they are still drawn)
+	if(	_sphereSlots.getCapacity() != _spheres.size() ||
+		2*_cylinderSlots.getCapacity() != _cylinders.size() ||
+		(size_t)_trianglesMesh.getVertexCount() != 6*_prismSlots.getCapacity() ||
+		_cylinderSlots.getUsed()*4 < _cylinderSlots.getCapacity() ||
+		_prismSlots.getUsed()*4 < _prismSlots.getCapacity()){
+		init(m, _numSegments, _minSphereRadius, _minCylinderRadius);
+		return;
+	}
+
+	// spheres
+	for(int s : freed_spheres){
+		_spheres[s].set(0, 0, 0, 0);
+	}
+	for(int s : new_spheres){
+		const DynamicMesh::Vertex * v = _sphereVertices[s];
+		_spheres[s].set(v->position, v->sphere_radius);
+	}
+	if(_sphereInstanceBuffer != 0){
+		glBindBuffer(GL_ARRAY_BUFFER, _sphereInstanceBuffer);
+		for(std::vector<int> * slots : {&freed_spheres, &new_spheres}){
+			for(int s : *slots){
+				Vector4D instance = getSphereInstance(s);
+				glBufferSubData(GL_ARRAY_BUFFER, _sphereInstanceIndex[s]*sizeof(Vector4D), sizeof(Vector4D), &instance);
+				Mesh::countUpload(sizeof(Vector4D));
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// cylinders, slots that are free are cleared (degenerated to a single point they are not rasterized)
+	std::vector<Vector3D> data(4*_lodSegments[0]);
+	std::vector<unsigned int> indices(6*_lodSegments[0]); // not used, element buffers do not change
+	for(int c : freed_cylinders){
+		if(_cylinderVertices[2*c] != nullptr){// slot has been reused
+			continue;
+		}
+		_cylinders[2*c].set(0, 0, 0, 0);
+		_cylinders[2*c + 1].set(0, 0, 0, 0);
+		std::fill(data.begin(), data.end(), Vector3D_zer0);
+		for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+			_cylinderMeshes[l].update3D((float*)data.data(), 2*c*_lodSegments[l], 2*_lodSegments[l]);
+		}
+	}
+	for(const std::pair<int, const DynamicMesh::Edge*> & c : new_cylinders){
+		Vector4D & start = _cylinders[2*c.first];
+		Vector4D & end = _cylinders[2*c.first + 1];
+		calculateCylinder(c.second->v[0], c.second->v[1], start, end);
+		for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+			const int vertex_count = 2*_lodSegments[l];
+			generateCylinder(start, end, _cylinderTemplates[l], data.data(), data.data() + vertex_count, indices.data(), 0);
+			_cylinderMeshes[l].update3D((float*)data.data(), c.first*vertex_count, vertex_count);
+		}
+	}
+	if(_coneInstanceBuffer != 0){
+		glBindBuffer(GL_ARRAY_BUFFER, _coneInstanceBuffer);
+		for(int c : freed_cylinders){
+			glBufferSubData(GL_ARRAY_BUFFER, 2*c*sizeof(Vector4D), 2*sizeof(Vector4D), &_cylinders[2*c]);
+			Mesh::countUpload(2*sizeof(Vector4D));
+		}
+		for(const std::pair<int, const DynamicMesh::Edge*> & c : new_cylinders){
+			glBufferSubData(GL_ARRAY_BUFFER, 2*c.first*sizeof(Vector4D), 2*sizeof(Vector4D), &_cylinders[2*c.first]);
+			Mesh::countUpload(2*sizeof(Vector4D));
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// prisms
+	const Vector3D zero_data[12];
+	for(int p : freed_prisms){
+		if(_prismVertices[3*p] == nullptr){
+			_trianglesMesh.update3D((float*)zero_data, 6*p, 6);
+			_prismBounds[p].set(0, 0, 0, 0);
+		}
+	}
+	Vector3D prism_data[12];
+	for(const std::pair<int, const DynamicMesh::Face*> & p : new_prisms){
+		generatePrism(p.second, prism_data, prism_data + 6);
+		_trianglesMesh.update3D((float*)prism_data, 6*p.first, 6);
+		_prismBounds[p.first] = getPrismBounds(p.second);
+	}
+}
+
+void SphereMesh::releasePrimitives(const DynamicMesh::Vertex * v, std::vector<int> & spheres, std::vector<int> & cylinders, std::vector<int> & prisms)
+{
+	std::unordered_map<const DynamicMesh::Vertex*, VertexPrimitives>::iterator it = _vertexPrimitives.find(v);
+	if(it == _vertexPrimitives.end()){
+		return;
+	}
+	VertexPrimitives & vp = it->second;
+	if(vp.sphere >= 0){
+		_sphereSlots.free(vp.sphere);
+		_sphereVertices[vp.sphere] = nullptr;
+		spheres.push_back(vp.sphere);
+		vp.sphere = -1;
+	}
+	// remove primitives from the other vertices they are connected to
+	for(int c : vp.cylinders){
+		for(int i = 0; i < 2; i++){
+			const DynamicMesh::Vertex * other = _cylinderVertices[2*c + i];
+			if(other != v){
+				std::vector<int> & other_cylinders = _vertexPrimitives[other].cylinders;
+				other_cylinders.erase(std::find(other_cylinders.begin(), other_cylinders.end(), c));
 			}
-			pos[c] = pos[0];
-			norm[c] = norm[0];
-			c++;
-			pos[c] = pos[1];
-			norm[c] = norm[1];
-
-			_cylinderMeshes[e_count].set3D(vertex_data, vertex_count, Mesh::NORMAL, GL_TRIANGLE_STRIP);
-			e_count++;
-		}
-	}
-	_cylinderMeshes.resize(e_count);
-	delete[] vertex_data;
-	vertex_data = nullptr;
-
-	// creating triangle mesh
-	const DynamicMesh::Face * face_i = m.getFaceList().getFirst();
-	size_t num_faces = m.getFaceList().getSize();
-	vertex_data = new float[num_floats_per_vert*3*num_faces*2];
-	Vector3D * face_p = (Vector3D*)(vertex_data);
-	Vector3D * face_n = (Vector3D*)(vertex_data+3*num_faces*3*2);
-	int face_count = 0;
+			_cylinderVertices[2*c + i] = nullptr;
+		}
+		_cylinderSlots.free(c);
+		cylinders.push_back(c);
+	}
+	vp.cylinders.clear();
+	for(int p : vp.prisms){
+		for(int i = 0; i < 3; i++){
+			const DynamicMesh::Vertex * other = _prismVertices[3*p + i];
+			if(other != v){
+				std::vector<int> & other_prisms = _vertexPrimitives[other].prisms;
+				other_prisms.erase(std::find(other_prisms.begin(), other_prisms.end(), p));
+			}
+			_prismVertices[3*p + i] = nullptr;
+		}
+		_prismSlots.free(p);
+		prisms.push_back(p);
+	}
+	vp.prisms.clear();
+}
+
+void SphereMesh::calculateCylinder(const DynamicMesh::Vertex * v0, const DynamicMesh::Vertex * v1, Vector4D & start, Vector4D & end)
+{
+	Vector4D s1(v0->position, v0->sphere_radius);
+	Vector4D s2(v1->position, v1->sphere_radius);
+	Vector2D off1, off2;
+	Vector3D t0;
+	calculateSphereTangent(s1, s2, off1, off2, &t0);
+	start.set(s1.getVector3D() + t0*off1.x, off1.y);
+	end.set(s2.getVector3D() + t0*off2.x, off2.y);
+}
+
+void SphereMesh::generatePrism(const DynamicMesh::Face * face, Vector3D * f, Vector3D * face_n)
+{
+	// calculate positions for face in normal direction
 	Vector2D offsets[6];
 	Vector2D norm_dirs[3];
-	for(; face_i != nullptr; face_i = face_i->getNext()){
-		// calculate positions for face in normal direction
-		Vector3D *f = &face_p[face_count*3*2];
-		Vector4D face_spheres[3];
-		Vector3D t0 = face_i->normal;
-		Vector3D t1, t2;
-		createOrthonormalBase(t0, t1, t2);
-		for(int vi = 0 ; vi < 3; vi++){
-			face_spheres[vi].set(face_i->v[vi]->position, face_i->v[vi]->sphere_radius);
-		}
-		// calculate cylinder offsets and radii
-		for(int vi = 0; vi < 3; vi++){
-			int vi_next = (vi+1)%3;
-			Vector3D n;
-			calculateSphereTangent(face_spheres[vi], face_spheres[vi_next], offsets[vi*2], offsets[vi*2+1], &n);
-			// project n onto this 2D face/plane defined by face normal
-			norm_dirs[vi].set(Vector3D::dot(n, t1), Vector3D::dot(n, t2));
-		}
+	Vector4D face_spheres[3];
+	Vector3D t0 = face->normal;
+	Vector3D t1, t2;
+	createOrthonormalBase(t0, t1, t2);
+	for(int vi = 0 ; vi < 3; vi++){
+		face_spheres[vi].set(face->v[vi]->position, face->v[vi]->sphere_radius);
+	}
+	// calculate cylinder offsets and radii
+	for(int vi = 0; vi < 3; vi++){
+		int vi_next = (vi+1)%3;
+		Vector3D n;
+		calculateSphereTangent(face_spheres[vi], face_spheres[vi_next], offsets[vi*2], offsets[vi*2+1], &n);
+		// project n onto this 2D face/plane defined by face normal
+		norm_dirs[vi].set(Vector3D::dot(n, t1), Vector3D::dot(n, t2));
+	}
 
-		bool visible = true;
-		// calculate intersections
-		for(int vi = 0; vi < 3; vi++){
-			int o1 = vi*2;
-			int o2 = (o1 + 5)%6;
-			int n1 = vi;
-			int n2 = (vi+2)%3;
-			float r = face_i->v[vi]->sphere_radius;
-			float r_2 = r*r;
-			if(r > 0.0f){// non-zer0 radius
-				Vector2D intersect;
-				if(intersectPlanes(norm_dirs[n1], offsets[o1].x, norm_dirs[n2], offsets[o2].x, intersect)){
-					float len_2 = intersect.getSquaredLength();
-					if(len_2 < r_2){
-						float z = sqrt(r_2-len_2);
-						Vector3D globalxy = face_i->v[vi]->position + intersect.x*t1 + intersect.y*t2;
-						Vector3D normal_offset = z*t0;
-						f[vi]   = globalxy + normal_offset;
-						f[vi+3] = globalxy - normal_offset;
-					}
-					else{// intersection outside of sphere -> cylinders do not intersect
-						visible = false;
-						break;
-					}
+	bool visible = true;
+	// calculate intersections
+	for(int vi = 0; vi < 3; vi++){
+		int o1 = vi*2;
+		int o2 = (o1 + 5)%6;
+		int n1 = vi;
+		int n2 = (vi+2)%3;
+		float r = face->v[vi]->sphere_radius;
+		float r_2 = r*r;
+		if(r > 0.0f){// non-zer0 radius
+			Vector2D intersect;
+			if(intersectPlanes(norm_dirs[n1], offsets[o1].x, norm_dirs[n2], offsets[o2].x, intersect)){
+				float len_2 = intersect.getSquaredLength();
+				if(len_2 < r_2){
+					float z = sqrt(r_2-len_2);
+					Vector3D globalxy = face->v[vi]->position + intersect.x*t1 + intersect.y*t2;
+					Vector3D normal_offset = z*t0;
+					f[vi]   = globalxy + normal_offset;
+					f[vi+3] = globalxy - normal_offset;
 				}
-				else{// no intersection -> we can skip this face, as it lies inside the spheres/cylinders and won't be visible
+				else{// intersection outside of sphere -> cylinders do not intersect
 					visible = false;
 					break;
 				}
 			}
-			else{
-				f[vi] = face_i->v[vi]->position;
-				f[vi+3] = f[vi];
+			else{// no intersection -> we can skip this face, as it lies inside the spheres/cylinders and won't be visible
+				visible = false;
+				break;
 			}
 		}
-		if(visible){
-			// calculate normal 1
-			Vector3D n = Vector3D::cross(f[1] - f[0], f[2] - f[0]);
-			for(int ni = 0; ni < 3; ni++){
-				face_n[face_count*3*2 + ni] = n;
-			}
+		else{
+			f[vi] = face->v[vi]->position;
+			f[vi+3] = f[vi];
+		}
+	}
+	if(visible){
+		// calculate normal 1
+		Vector3D n = Vector3D::cross(f[1] - f[0], f[2] - f[0]);
+		for(int ni = 0; ni < 3; ni++){
+			face_n[ni] = n;
+		}
 
-			// calculate normal 2
-			n = -Vector3D::cross(f[4] - f[3], f[5] - f[3]);
-			for(int ni = 0; ni < 3; ni++){
-				face_n[face_count*3*2 + ni + 3] = n;
-			}
+		// calculate normal 2
+		n = -Vector3D::cross(f[4] - f[3], f[5] - f[3]);
+		for(int ni = 0; ni < 3; ni++){
+			face_n[ni + 3] = n;
+		}
+	}
+	else{
+		// set face to the original face
+		for(int vi = 0; vi < 3; vi++){
+			f[vi] = face->v[vi]->position + face->v[vi]->sphere_radius*face->normal;
+			f[vi+3] = face->v[vi]->position - face->v[vi]->sphere_radius*face->normal;
+			face_n[vi] = face->normal;
+			face_n[vi+3] = -face->normal;
+		}
+	}
+	// reorder verticies for back faces to be culled correctly
+	Vector3D swap = f[3];
+	f[3] = f[4];
+	f[4] = swap;
+}
+
+SphereMesh::CylinderTemplate::CylinderTemplate(int num_segments):
+	numSegments(num_segments), cosTable(num_segments), sinTable(num_segments), indices(6*num_segments)
+{
+	for(int i = 0; i < num_segments; i++){
+		float angle = 2*M_PI*i/num_segments;
+		cosTable[i] = cos(angle);
+		sinTable[i] = sin(angle);
+
+		// two triangles connecting this segment with the next one (same winding as a triangle strip)
+		unsigned int i_end = 2*i;
+		unsigned int i_next_end = 2*((i+1)%num_segments);
+		indices[i*6 + 0] = i_end;
+		indices[i*6 + 1] = i_end + 1;
+		indices[i*6 + 2] = i_next_end;
+		indices[i*6 + 3] = i_next_end;
+		indices[i*6 + 4] = i_end + 1;
+		indices[i*6 + 5] = i_next_end + 1;
+	}
+}
+
+#ifdef __SSE__
+/* write 4 segments given as x/y/z components of end and start vertices to out, alternating between end and start (24 floats) */
+static inline void storeRingSegments(float * out, __m128 ex, __m128 ey, __m128 ez, __m128 sx, __m128 sy, __m128 sz)
+{
+	// rows after transpose: (ex_i, ey_i, ez_i, sx_i) and (sy_i, sz_i, 0, 0) for segment i
+	__m128 q2 = _mm_setzero_ps();
+	__m128 q3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(ex, ey, ez, sx);
+	_MM_TRANSPOSE4_PS(sy, sz, q2, q3);
+	_mm_storeu_ps(out +  0, ex);
+	_mm_storeu_ps(out +  4, _mm_movelh_ps(sy, ey));
+	_mm_storeu_ps(out +  8, _mm_shuffle_ps(ey, sz, _MM_SHUFFLE(1, 0, 3, 2)));
+	_mm_storeu_ps(out + 12, ez);
+	_mm_storeu_ps(out + 16, _mm_movelh_ps(q2, sx));
+	_mm_storeu_ps(out + 20, _mm_shuffle_ps(sx, q3, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+#endif
+
+void SphereMesh::generateCylinder(const Vector4D & start, const Vector4D & end, const CylinderTemplate & t,
+								Vector3D * pos, Vector3D * norm, unsigned int * indices, unsigned int first_vertex)
+{
+	// create local orthonormal coordinate system t0, t1, t2
+	Vector3D start_pos = start.getVector3D();
+	Vector3D end_pos = end.getVector3D();
+	float r1 = start.w;
+	float r2 = end.w;
+	Vector3D t0 = (end_pos-start_pos).getNormalized();
+	float len = (start_pos-end_pos).getLength();
+	Vector3D t1, t2;
+	createOrthonormalBase(t0, t1, t2);
+
+	// circle point c = cos*t1 + sin*t2 is orthogonal to t0 and unit length,
+	// so every normal (c - sin_alpha*t0) has the same length and can be normalized by a constant factor
+	float sin_alpha = (r2-r1)/len;
+	float n_scale = 1.0f/sqrt(1.0f + sin_alpha*sin_alpha);
+	Vector3D n1 = t1*n_scale;
+	Vector3D n2 = t2*n_scale;
+	Vector3D n0 = t0*(-sin_alpha*n_scale);
+	const int num_segments = t.numSegments;
+	int i = 0;
+#ifdef __SSE__
+	const __m128 t1x = _mm_set1_ps(t1.x), t1y = _mm_set1_ps(t1.y), t1z = _mm_set1_ps(t1.z);
+	const __m128 t2x = _mm_set1_ps(t2.x), t2y = _mm_set1_ps(t2.y), t2z = _mm_set1_ps(t2.z);
+	const __m128 n0x = _mm_set1_ps(n0.x), n0y = _mm_set1_ps(n0.y), n0z = _mm_set1_ps(n0.z);
+	const __m128 vn_scale = _mm_set1_ps(n_scale), vr1 = _mm_set1_ps(r1), vr2 = _mm_set1_ps(r2);
+	const __m128 ex = _mm_set1_ps(end_pos.x), ey = _mm_set1_ps(end_pos.y), ez = _mm_set1_ps(end_pos.z);
+	const __m128 sx = _mm_set1_ps(start_pos.x), sy = _mm_set1_ps(start_pos.y), sz = _mm_set1_ps(start_pos.z);
+	for(; i + 4 <= num_segments; i += 4){
+		__m128 c = _mm_loadu_ps(&t.cosTable[i]);
+		__m128 s = _mm_loadu_ps(&t.sinTable[i]);
+		__m128 cx = _mm_add_ps(_mm_mul_ps(c, t1x), _mm_mul_ps(s, t2x));
+		__m128 cy = _mm_add_ps(_mm_mul_ps(c, t1y), _mm_mul_ps(s, t2y));
+		__m128 cz = _mm_add_ps(_mm_mul_ps(c, t1z), _mm_mul_ps(s, t2z));
+		storeRingSegments((float*)(pos + 2*i),
+						_mm_add_ps(ex, _mm_mul_ps(vr2, cx)), _mm_add_ps(ey, _mm_mul_ps(vr2, cy)), _mm_add_ps(ez, _mm_mul_ps(vr2, cz)),
+						_mm_add_ps(sx, _mm_mul_ps(vr1, cx)), _mm_add_ps(sy, _mm_mul_ps(vr1, cy)), _mm_add_ps(sz, _mm_mul_ps(vr1, cz)));
+		__m128 nx = _mm_add_ps(_mm_mul_ps(cx, vn_scale), n0x);
+		__m128 ny = _mm_add_ps(_mm_mul_ps(cy, vn_scale), n0y);
+		__m128 nz = _mm_add_ps(_mm_mul_ps(cz, vn_scale), n0z);
+		storeRingSegments((float*)(norm + 2*i), nx, ny, nz, nx, ny, nz);
+	}
+#endif
+	// remaining segments (all segments if SSE is not available)
+	for(; i < num_segments; i++){
+		Vector3D circle_pos = t.cosTable[i]*t1 + t.sinTable[i]*t2;
+		Vector3D n = t.cosTable[i]*n1 + t.sinTable[i]*n2 + n0;
+		pos[2*i] = end_pos + r2*circle_pos;
+		norm[2*i] = n;
+		pos[2*i + 1] = start_pos + r1*circle_pos;
+		norm[2*i + 1] = n;
+	}
+
+	for(int j = 0; j < 6*num_segments; j++){
+		indices[j] = t.indices[j] + first_vertex;
+	}
+}
+
+int SphereMesh::selectLOD(float radius, float depth, float pixel_scale)const
+{
+	if(depth <= radius){// camera inside or very close
+		return 0;
+	}
+	float needed_segments = 2*M_PI*radius*pixel_scale/(depth*SPHERE_MESH_LOD_PIXELS_PER_SEGMENT);
+	int l = SPHERE_MESH_NUM_LODS-1;
+	while(l > 0 && _lodSegments[l] < needed_segments){
+		l--;
+	}
+	return l;
+}
+
+bool SphereMesh::updateLOD(const Matrix4 & view, const Matrix4 & projection, float viewport_height)
+{
+	// projected radius in pixels = radius*pixel_scale/depth
+	float pixel_scale = ((const float*)projection)[5]*viewport_height*0.5f;
+	Matrix4 m;
+	m.setTranslation(_position);
+	Matrix4 mv = view*m;
+	// primitives are tested in model space
+	Frustum frustum(projection*mv);
+
+	bool spheres_changed = false;
+	for(size_t i = 0; i < _spheres.size(); i++){
+		Vector3D center = _spheres[i].getVector3D();
+		float radius = _spheres[i].w-_sphereRadiusOffset;
+		unsigned char l = SPHERE_MESH_CULLED;
+		if(frustum.intersectsSphere(center, radius)){
+			float depth = -(mv*Vector4D(center, 1)).z;
+			l = selectLOD(radius, depth, pixel_scale);
+		}
+		if(l != _sphereLOD[i]){
+			_sphereLOD[i] = l;
+			spheres_changed = true;
+		}
+	}
+
+	bool cylinders_changed = false;
+	for(size_t i = 0; i < _cylinderLOD.size(); i++){
+		const Vector4D & start = _cylinders[2*i];
+		const Vector4D & end = _cylinders[2*i+1];
+		float radius = std::max(start.w, end.w);
+		unsigned char l = SPHERE_MESH_CULLED;
+		if(frustum.intersectsSphere((start.getVector3D()+end.getVector3D())*0.5f, (end.getVector3D()-start.getVector3D()).getLength()*0.5f + radius)){
+			float depth = std::min(-(mv*Vector4D(start.getVector3D(), 1)).z, -(mv*Vector4D(end.getVector3D(), 1)).z);
+			l = selectLOD(radius, depth, pixel_scale);
+		}
+		if(l != _cylinderLOD[i]){
+			_cylinderLOD[i] = l;
+			cylinders_changed = true;
+		}
+	}
+
+	bool prisms_changed = false;
+	for(size_t i = 0; i < _prismBounds.size(); i++){
+		unsigned char visible = frustum.intersectsSphere(_prismBounds[i].getVector3D(), _prismBounds[i].w);
+		if(visible != _prismVisible[i]){
+			_prismVisible[i] = visible;
+			prisms_changed = true;
+		}
+	}
+
+	if(spheres_changed){
+		uploadSphereInstances();
+	}
+	if(cylinders_changed){
+		updateCylinderRanges();
+	}
+	if(prisms_changed){
+		updatePrismRanges();
+	}
+	return spheres_changed || cylinders_changed || prisms_changed;
+}
+
+void SphereMesh::updateCylinderRanges()
+{
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		_cylinderRangeFirst[l].clear();
+		_cylinderRangeCount[l].clear();
+	}
+	for(size_t i = 0; i < _cylinderLOD.size(); i++){
+		int l = _cylinderLOD[i];
+		if(l == SPHERE_MESH_CULLED){
+			continue;
+		}
+		GLsizei index_count = _lodSegments[l]*6;
+		GLsizei first = i*index_count;
+		std::vector<GLsizei> & firsts = _cylinderRangeFirst[l];
+		std::vector<GLsizei> & counts = _cylinderRangeCount[l];
+		// extend previous range if cylinders are adjacent in the element buffer
+		if(!firsts.empty() && firsts.back() + counts.back() == first){
+			counts.back() += index_count;
 		}
 		else{
-			// set face to the original face
-			for(int vi = 0; vi < 3; vi++){
-				f[vi] = face_i->v[vi]->position + face_i->v[vi]->sphere_radius*face_i->normal;
-				f[vi+3] = face_i->v[vi]->position - face_i->v[vi]->sphere_radius*face_i->normal;
-				face_n[face_count*3*2 + vi ] = face_i->normal;
-				face_n[face_count*3*2 + vi +3] = -face_i->normal;
-			}
+			firsts.push_back(first);
+			counts.push_back(index_count);
 		}
-		// reorder verticies for back faces to be culled correctly
-		Vector3D swap = f[3];
-		f[3] = f[4];
-		f[4] = swap;
-		face_count++;
 	}
-	_trianglesMesh.set3D(vertex_data, 2*3*face_count, Mesh::NORMAL, GL_TRIANGLES);
-	delete[] vertex_data;
+}
+
+void SphereMesh::updatePrismRanges()
+{
+	_prismRangeFirst.clear();
+	_prismRangeCount.clear();
+	for(size_t i = 0; i < _prismVisible.size(); i++){
+		if(!_prismVisible[i]){
+			continue;
+		}
+		// extend previous range if the prisms are adjacent in the vertex buffer
+		GLsizei first = 6*i;
+		if(!_prismRangeFirst.empty() && _prismRangeFirst.back() + _prismRangeCount.back() == first){
+			_prismRangeCount.back() += 6;
+		}
+		else{
+			_prismRangeFirst.push_back(first);
+			_prismRangeCount.push_back(6);
+		}
+	}
+}
+
+Vector4D SphereMesh::getPrismBounds(const DynamicMesh::Face * face)
+{
+	Vector3D center = (face->v[0]->position + face->v[1]->position + face->v[2]->position)/3.f;
+	float radius = 0;
+	for(int i = 0; i < 3; i++){
+		radius = std::max(radius, (face->v[i]->position-center).getLength() + face->v[i]->sphere_radius);
+	}
+	return Vector4D(center, radius);
 }
 
 void SphereMesh::draw()
@@ -193,16 +699,82 @@ void SphereMesh::draw()
 	drawTriangles();
 }
 
+void SphereMesh::uploadSphereInstances()
+{
+	if(!CONFIG.SUPPORTS_NEW_GL){
+		return;
+	}
+	// sort instances by level of detail, so every level can be drawn with a single instanced draw call, culled spheres are last
+	GLsizei first[SPHERE_MESH_NUM_LODS+1];
+	for(int l = 0; l <= SPHERE_MESH_CULLED; l++){
+		_sphereLODCount[l] = 0;
+	}
+	for(unsigned char l : _sphereLOD){
+		_sphereLODCount[l]++;
+	}
+	first[0] = 0;
+	for(int l = 1; l <= SPHERE_MESH_CULLED; l++){
+		first[l] = first[l-1] + _sphereLODCount[l-1];
+	}
+	std::vector<Vector4D> instances(_spheres.size());
+	_sphereInstanceIndex.resize(_spheres.size());
+	for(size_t i = 0; i < _spheres.size(); i++){
+		_sphereInstanceIndex[i] = first[_sphereLOD[i]]++;
+		instances[_sphereInstanceIndex[i]] = getSphereInstance(i);
+	}
+	if(_sphereInstanceBuffer == 0){
+		glGenBuffers(1, &_sphereInstanceBuffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, _sphereInstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Vector4D)*instances.size(), instances.data(), GL_STATIC_DRAW);
+	Mesh::countUpload(sizeof(Vector4D)*instances.size(), true);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+Vector4D SphereMesh::getSphereInstance(size_t slot)const
+{
+	if(_sphereVertices[slot] == nullptr){
+		return Vector4D(0, 0, 0, 0);
+	}
+	return Vector4D(_spheres[slot].getVector3D(), _spheres[slot].w-_sphereRadiusOffset);
+}
+
 void SphereMesh::drawSpheres()
 {
 	Matrix4 m;
 	// draw spheres
 	SHADER->setColor(_sphereColor);
-	_sphereMesh.bind();
-	for(const Vector4D & v : _spheres){
+	if(_sphereInstanceBuffer != 0 && SHADER->getInstanceLocation() >= 0){
+		// single draw call per level, every instance is moved and scaled by its sphere
+		m.setTranslation(_position);
+		SHADER->setModelMatrix(m);
+		size_t first = 0;
+		for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+			if(_sphereLODCount[l] == 0){
+				continue;
+			}
+			_sphereMeshes[l].bind();
+			glBindBuffer(GL_ARRAY_BUFFER, _sphereInstanceBuffer);
+			SHADER->setInstancePointer(4, 0, first*sizeof(Vector4D));
+			_sphereMeshes[l].drawInstanced(_sphereLODCount[l]);
+			// instance array would otherwise stay enabled in the vertex array object of this level
+			SHADER->disableInstanceArray();
+			first += _sphereLODCount[l];
+		}
+		SHADER->setInstance(Vector4D(0, 0, 0, 1));
+		return;
+	}
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		_sphereMeshes[l].bind();
+		for(size_t i = 0; i < _spheres.size(); i++){
+			if(_sphereLOD[i] != l || _sphereVertices[i] == nullptr){
+				continue;
+			}
+			const Vector4D & v = _spheres[i];
 			m.setTransform(_position + v.getVector3D(), v.w-_sphereRadiusOffset, Vector3D_zer0);
 			SHADER->setModelMatrix(m);
-			_sphereMesh.draw();
+			_sphereMeshes[l].draw();
+		}
 	}
 }
 
@@ -211,11 +783,14 @@ void SphereMesh::drawCylinders()
 	Matrix4 m;
 	m.setTranslation(_position);
 	SHADER->setModelMatrix(m);
-	// draw cylinders
+	// draw cylinders, one draw call per level
 	SHADER->setColor(_cylinderColor);
-	for(size_t i = 0; i < _cylinderMeshes.size(); i++){
-		_cylinderMeshes[i].bind();
-		_cylinderMeshes[i].draw();
+	for(int l = 0; l < SPHERE_MESH_NUM_LODS; l++){
+		if(_cylinderRangeFirst[l].empty()){
+			continue;
+		}
+		_cylinderMeshes[l].bind();
+		_cylinderMeshes[l].drawRanges(_cylinderRangeFirst[l].data(), _cylinderRangeCount[l].data(), _cylinderRangeFirst[l].size());
 	}
 }
 
@@ -225,9 +800,65 @@ void SphereMesh::drawTriangles()
 	m.setTranslation(_position);
 	SHADER->setModelMatrix(m);
 	// draw triangles
+	if(_prismRangeFirst.empty()){
+		return;
+	}
 	SHADER->setColor(_triangleColor);
 	_trianglesMesh.bind();
-	_trianglesMesh.draw();
+	_trianglesMesh.drawRanges(_prismRangeFirst.data(), _prismRangeCount.data(), _prismRangeFirst.size());
+}
+
+bool SphereMesh::beginImpostorDraw()
+{
+	// draw back faces of proxy boxes only, so every covered pixel is ray-casted once (also if the camera is inside a box)
+	bool cull_enabled = glIsEnabled(GL_CULL_FACE);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_FRONT);
+	Matrix4 m;
+	m.setTranslation(_position);
+	SHADER->setModelMatrix(m);
+	_proxyBox.bind(0);
+	return cull_enabled;
+}
+
+void SphereMesh::endImpostorDraw(bool cull_enabled)
+{
+	SHADER->disableInstanceArray();
+	glCullFace(GL_BACK);
+	if(!cull_enabled){
+		glDisable(GL_CULL_FACE);
+	}
+}
+
+void SphereMesh::drawSphereImpostors(ImpostorShader & sphere_shader)
+{
+	if(_sphereInstanceBuffer == 0 || _spheres.empty()){
+		return;
+	}
+	sphere_shader.use();
+	SHADER->setColor(_sphereColor);
+	bool cull_enabled = beginImpostorDraw();
+	glBindBuffer(GL_ARRAY_BUFFER, _sphereInstanceBuffer);
+	SHADER->setInstancePointer();
+	// culled spheres are at the end of the instance buffer
+	_proxyBox.drawInstanced(_spheres.size() - _sphereLODCount[SPHERE_MESH_CULLED]);
+	endImpostorDraw(cull_enabled);
+}
+
+void SphereMesh::drawCylinderImpostors(ImpostorShader & cone_shader)
+{
+	if(_coneInstanceBuffer == 0 || _cylinders.empty()){
+		return;
+	}
+	cone_shader.use();
+	SHADER->setColor(_cylinderColor);
+	bool cull_enabled = beginImpostorDraw();
+	glBindBuffer(GL_ARRAY_BUFFER, _coneInstanceBuffer);
+	SHADER->setInstancePointer(4, 2*sizeof(Vector4D), 0);
+	cone_shader.setInstanceEndPointer(2*sizeof(Vector4D), sizeof(Vector4D));
+	_proxyBox.drawInstanced(_cylinders.size()/2);
+	cone_shader.disableInstanceEndArray();
+	endImpostorDraw(cull_enabled);
 }
 
 void SphereMesh::calculateSphereTangent(const zer0::Vector4D & s1, const zer0::Vector4D & s2,
@@ -4,7 +4,19 @@
 #include "zer0engine/zMath.h"
 #include "zer0engine/zMesh.h"
 #include "DynamicMesh.h"
+#include "ImpostorShader.h"
+#include "zer0engine/zSlotAllocator.h"
+#include "zer0engine/zFrustum.h"
 #include <vector>
+#include <set>
+#include <unordered_map>
+
+/* number of precomputed levels of detail for spheres and cylinders, every level halves the number of segments */
+#define SPHERE_MESH_NUM_LODS 4
+/* coarsest level of detail is chosen so that a single segment covers at most this many pixels of the silhouette */
+#define SPHERE_MESH_LOD_PIXELS_PER_SEGMENT 2.0f
+/* level of primitives outside of the view frustum, they are not drawn */
+#define SPHERE_MESH_CULLED SPHERE_MESH_NUM_LODS
 
 /* Sphere Mesh for drawing interpolated spheres along edges and faces
  * vertices = spheres
@@ -15,17 +27,33 @@ class SphereMesh
 {
 public:
 	SphereMesh(float sphere_radius_offset = 0);
+	~SphereMesh();
 	
 	/*
 	 * initialize from dynamic mesh
 	 * @m the dynamic mesh to generate the sphere mesh from
 	 * @num_segments is the number of segments used to generate the sphere and cylinder mesh, more segments = more smooth
+	 *  (this is the finest level of detail, see updateLOD())
 	 * @min_sphere_radius if a sphere radius falls below this value, the sphere is not being rendered
 	 * @cylinder_radius_offset offset cylinder radius by given amount so it doesn't 'punch through' sphere
 	 * @min_cylinder_radius if both radii of a cylinder fall below this value, the cylinder is not being rendered
 	 */
 	void init(const DynamicMesh & m, int num_segments = 32, float min_sphere_radius = 0.001f, float min_cylinder_radius = 0.001f);
 
+	/*
+	 * regenerate only the spheres, cylinders and prisms connected to the given vertices (see DynamicMesh::getChangedVertices())
+	 * Every primitive keeps a fixed slot in the vertex buffers, slots of removed primitives are cleared and reused later.
+	 * Falls back to init() (with the parameters of the last call) if the buffers have to grow or most slots would be unused.
+	 * @m the dynamic mesh the sphere mesh was initialized from
+	 * @changed vertices that were moved or got a new radius since the last call to init()/update()
+	 * @removed vertices that were removed since the last call to init()/update() (only used as keys, never dereferenced)
+	 */
+	void update(const DynamicMesh & m, const std::set<DynamicMesh::Vertex*> & changed,
+				const std::vector<const DynamicMesh::Vertex*> & removed);
+
+	/* true if init() has been called since construction or the last clear() */
+	bool isInitialized()const{return !_cylinderTemplates.empty();}
+
 	/* 
 	 * set colors for drawing
 	 */
@@ -40,6 +68,7 @@ public:
 	 */
 	void setSphereRadiusOffset(float r_decrease){
 		_sphereRadiusOffset = r_decrease;
+		uploadSphereInstances();
 	}
 
 	/*
@@ -52,14 +81,41 @@ public:
 	 */
 	void clear();
 
+	/*
+	 * select level of detail for every sphere and cylinder from its projected radius on screen
+	 * and skip spheres, cylinders and prisms whose bounding sphere lies outside of the view frustum
+	 * until this is called all primitives are drawn with the finest level
+	 * NOTE: primitives replaced by update() keep the visibility of their slot until the next call
+	 * @view view matrix of the camera
+	 * @projection perspective projection matrix
+	 * @viewport_height height of the viewport in pixels
+	 * @return true if the level or visibility of any primitive has changed
+	 */
+	bool updateLOD(const zer0::Matrix4 & view, const zer0::Matrix4 & projection, float viewport_height);
+
 	/* render all  calls drawSpheres(), drawCylinders() and drawTriangles() */
 	void draw();
 
-	/* draw only single component */
+	/* draw only single component
+	 * NOTE: if OpenGL 3.3 is supported and the current shader has an instance attribute (see DiffuseShader),
+	 *  all spheres are drawn with a single instanced draw call, otherwise one draw call is issued per sphere
+	 */
 	void drawSpheres();
 	void drawCylinders();
 	void drawTriangles();
 
+	/* 
+	 * draw spheres/cylinders as ray-casted impostors (exact at any zoom level), one instanced draw call each
+	 * spheres culled by updateLOD() are skipped, cylinders are always drawn
+	 * the given shader is made current, projection and view matrix must already be set in the shader
+	 * NOTE: only available if supportsImpostors() returns true
+	 */
+	void drawSphereImpostors(ImpostorShader & sphere_shader);
+	void drawCylinderImpostors(ImpostorShader & cone_shader);
+
+	/* impostors require OpenGL 3.3 */
+	static bool supportsImpostors(){return zer0::CONFIG.SUPPORTS_NEW_GL;}
+
 	/* 
 	 * Calculate the offsets from sphere centers the tangent points of a plane will have on two spheres.
 	 * This is needed for calculating the cylinders and triangles (interpolated spheres) of the sphere mesh.
@@ -87,10 +143,104 @@ public:
 	 */
 	static void createOrthonormalBase(const zer0::Vector3D & t0, zer0::Vector3D & t1, zer0::Vector3D & t2);
 private:
+	/* upload sphere centers and radii to instance buffer sorted by level of detail (only if OpenGL 3.3 is supported) */
+	void uploadSphereInstances();
+
+	/* get instance data (center and radius minus offset) of given sphere slot, zero for free slots */
+	zer0::Vector4D getSphereInstance(size_t slot)const;
+
+	/* move cylinder ends to the tangent points on both spheres */
+	static void calculateCylinder(const DynamicMesh::Vertex * v0, const DynamicMesh::Vertex * v1, zer0::Vector4D & start, zer0::Vector4D & end);
+
+	/* free slots of all primitives connected to given vertex, freed slots are appended to the given lists */
+	void releasePrimitives(const DynamicMesh::Vertex * v, std::vector<int> & spheres, std::vector<int> & cylinders, std::vector<int> & prisms);
+
+	/* collect element ranges of cylinders for every level of detail */
+	void updateCylinderRanges();
+
+	/* collect vertex ranges of prisms that are not culled */
+	void updatePrismRanges();
+
+	/* bounding sphere (center xyz, radius w) of the prism of a face, encloses the spheres of all three vertices */
+	static zer0::Vector4D getPrismBounds(const DynamicMesh::Face * face);
+
+	/* get coarsest level of detail with enough segments for a primitive of given radius at given view depth */
+	int selectLOD(float radius, float depth, float pixel_scale)const;
+
+	/*
+	 * generate triangle prism (6 vertices, 2 triangles) interpolating the spheres of a face
+	 * @pos/@norm arrays to write 6 positions/normals to
+	 */
+	static void generatePrism(const DynamicMesh::Face * face, zer0::Vector3D * pos, zer0::Vector3D * norm);
+
+	/*
+	 * data shared by all cylinders with the same number of segments:
+	 * unit circle (cos/sin of every segment angle) and indices of a cylinder starting at vertex 0
+	 */
+	struct CylinderTemplate{
+		CylinderTemplate(int num_segments);
+		int numSegments;
+		std::vector<float> cosTable;
+		std::vector<float> sinTable;
+		std::vector<unsigned int> indices;
+	};
+
+	/*
+	 * generate vertices (alternating between end and start circle) and indices for a single cylinder
+	 * @pos/@norm arrays to write 2*t.numSegments positions/normals to
+	 * @indices array to write 6*t.numSegments indices to
+	 * @first_vertex index of first vertex of this cylinder in the vertex buffer
+	 * NOTE: with SSE available, 4 segments of the ring are generated at once
+	 */
+	static void generateCylinder(const zer0::Vector4D & start, const zer0::Vector4D & end, const CylinderTemplate & t,
+								zer0::Vector3D * pos, zer0::Vector3D * norm, unsigned int * indices, unsigned int first_vertex);
+
+	/* set up state shared by all impostor draws, returns whether face culling was enabled before */
+	bool beginImpostorDraw();
+	void endImpostorDraw(bool cull_enabled);
+
 	zer0::Vector3D _position;	
 	std::vector<zer0::Vector4D> _spheres;
-	zer0::Mesh _sphereMesh;
-	std::vector<zer0::Mesh> _cylinderMeshes;
+	std::vector<zer0::Vector4D> _cylinders; // start (xyz) and radius (w) followed by end and radius for every cylinder
+	GLuint _sphereInstanceBuffer; // center (xyz) and radius (w) of every sphere, 0 if instancing is not supported
+	GLuint _coneInstanceBuffer; // start/end (xyz) and radius (w) of every cylinder, 0 if instancing is not supported
+	zer0::Mesh _proxyBox; // box drawn for every impostor
+
+	/* level of detail, level 0 is the finest */
+	int _lodSegments[SPHERE_MESH_NUM_LODS]; // number of segments for every level
+	zer0::Mesh _sphereMeshes[SPHERE_MESH_NUM_LODS]; // unit sphere for every level
+	zer0::Mesh _cylinderMeshes[SPHERE_MESH_NUM_LODS]; // all cylinders in one indexed triangle mesh for every level
+	std::vector<unsigned char> _sphereLOD; // current level of every sphere
+	std::vector<unsigned char> _cylinderLOD; // current level of every cylinder
+	GLsizei _sphereLODCount[SPHERE_MESH_NUM_LODS+1]; // number of spheres per level including culled (instance buffer is sorted by level)
+	std::vector<GLsizei> _cylinderRangeFirst[SPHERE_MESH_NUM_LODS]; // element ranges of cylinders to draw with every level
+	std::vector<GLsizei> _cylinderRangeCount[SPHERE_MESH_NUM_LODS];
+	std::vector<CylinderTemplate> _cylinderTemplates; // one for every level
+
+	/* prisms are culled individually, adjacent visible prisms are merged into ranges of a single draw call */
+	std::vector<zer0::Vector4D> _prismBounds; // bounding sphere of every prism slot
+	std::vector<unsigned char> _prismVisible; // prism slot is inside the view frustum
+	std::vector<GLsizei> _prismRangeFirst; // vertex ranges of prisms to draw
+	std::vector<GLsizei> _prismRangeCount;
+
+	/* slot of every primitive in the buffers, used by update() */
+	struct VertexPrimitives{
+		VertexPrimitives(): sphere(-1){}
+		int sphere; // -1 if sphere is not drawn
+		std::vector<int> cylinders;
+		std::vector<int> prisms;
+	};
+	std::unordered_map<const DynamicMesh::Vertex*, VertexPrimitives> _vertexPrimitives; // primitives connected to a vertex
+	std::vector<const DynamicMesh::Vertex*> _sphereVertices; // vertex of every sphere slot, nullptr if slot is free
+	std::vector<const DynamicMesh::Vertex*> _cylinderVertices; // 2 vertices per cylinder slot, nullptr if slot is free
+	std::vector<const DynamicMesh::Vertex*> _prismVertices; // 3 vertices per prism slot, nullptr if slot is free
+	zer0::SlotAllocator _sphereSlots;
+	zer0::SlotAllocator _cylinderSlots;
+	zer0::SlotAllocator _prismSlots;
+	std::vector<GLsizei> _sphereInstanceIndex; // position of every sphere slot in the instance buffer
+	int _numSegments;
+	float _minSphereRadius;
+	float _minCylinderRadius;
 	zer0::Mesh _trianglesMesh;
 
 	zer0::Color _sphereColor;
@@ -3,6 +3,9 @@
 #include "zer0engine/zer0engine.h"
 #include "ModelViewer.h"
 #include "CmdParser.h"
+#include "BatchProcessor.h"
+#include "Benchmark.h"
+#include <sys/stat.h>
 
 
 int main(int argc, char ** argv){
@@ -43,7 +46,7 @@ int main(int argc, char ** argv){
 		"obj", 'o',
 		".obj model to load from file.",
 		"data/cube.obj",
-		CmdParser::IS_FILE | CmdParser::REQUIRED
+		CmdParser::IS_FILE
 	);
 
 	auto cmd_spheres = cmd.addArg<int>(
@@ -52,19 +55,129 @@ int main(int argc, char ** argv){
 		20
 	);
 
+	auto cmd_snapshot_interval = cmd.addArg<int>(
+		"snapshot-interval", '\0',
+		"Number of edge collapses between two intermediate results shown while approximating, 0 to only show the final result.",
+		500
+	);
+
+	auto cmd_batch = cmd.addArg<std::string>(
+		"batch", 'b',
+		"Process all .obj models in given directory or listed in given manifest file (one '<obj> [<num_spheres>]' per line) without opening a window.",
+		"",
+		CmdParser::IS_FILE
+	);
+
+	auto cmd_threads = cmd.addArg<int>(
+		"threads", 't',
+		"Number of worker threads for batch processing, 0 for one thread per CPU core.",
+		0
+	);
+
+	auto cmd_output = cmd.addArg<std::string>(
+		"output", '\0',
+		"Directory to write batch results and summary table to.",
+		"batch_output"
+	);
+
+	auto cmd_previews = cmd.addArg<bool>(
+		"previews", '\0',
+		"Batch mode: write an image of every model next to its sphere mesh to the output directory (size given by window-w/window-h), no display needed.",
+		false
+	);
+
+	auto cmd_benchmark = cmd.addArg<int>(
+		"benchmark", '\0',
+		"Render given number of frames of a camera orbit around the sphere mesh of the model offscreen and print frame times and draw statistics (size given by window-w/window-h), 0 to disable. Runs with software OpenGL (e.g. LIBGL_ALWAYS_SOFTWARE=1).",
+		0
+	);
+
+	auto cmd_segments = cmd.addArg<int>(
+		"segments", '\0',
+		"Benchmark: number of segments of spheres and cylinders at the finest level of detail.",
+		64
+	);
+
+	auto cmd_stats = cmd.addArg<bool>(
+		"stats", '\0',
+		"Log frames per second and draw calls, uploads etc. of the last frame every second.",
+		false
+	);
+
+	auto cmd_async_log = cmd.addArg<bool>(
+		"async-log", '\0',
+		"Write log output from a background thread.",
+		false
+	);
+
 	cmd.addHelp();
 	CmdParser::Result r = cmd.parse(argc, argv);
 	if(r == CmdParser::HELP){
 		std::cout<<"Basic usage: "<<argv[0]<<" -o <obj> -s <num_spheres>"<<std::endl;
+		std::cout<<"Batch usage: "<<argv[0]<<" -b <directory|manifest> -s <num_spheres> -t <num_threads>"<<std::endl;
+		std::cout<<"Benchmark usage: "<<argv[0]<<" -o <obj> -s <num_spheres> --benchmark <num_frames> --segments <num_segments>"<<std::endl;
 		std::cout<<cmd.getHelpString()<<std::endl;
 		return 0;
 	}else if(r == CmdParser::ERROR){
 		std::cout<<"Error: "<<cmd.getError()<<std::endl;
 		return 1;
 	}
+	bool batch_mode = cmd_batch->isSet();
+	if(!batch_mode && !cmd_model->isSet()){
+		std::cout<<"Error: Either argument '--obj' or '--batch' has to be specified. Type '"<<argv[0]<<" --help' for help."<<std::endl;
+		return 1;
+	}
+
+	/* process models without window */
+	if(batch_mode){
+		zer0::init("Sphere Mesh Approximation", false);
+		zer0::LOG->setAsync(cmd_async_log->getValue());
+		BatchProcessor batch;
+		if(cmd_previews->getValue()){
+			if(!zer0::FW->createOffscreen(cmd_window_w->getValue(), cmd_window_h->getValue())){
+				zer0::ERROR("Offscreen context creation failed!");
+				zer0::shutdown();
+				return 2;
+			}
+			batch.setPreviews(true);
+		}
+		const std::string & input = cmd_batch->getValue();
+		struct stat input_stat;
+		bool ok;
+		if(stat(input.c_str(), &input_stat) == 0 && S_ISDIR(input_stat.st_mode)){
+			ok = batch.addDirectory(input, cmd_spheres->getValue());
+		}
+		else{
+			ok = batch.addManifest(input, cmd_spheres->getValue());
+		}
+		if(ok){
+			ok = batch.run(cmd_threads->getValue(), cmd_output->getValue());
+		}
+		zer0::shutdown();
+		return ok ? 0 : 3;
+	}
+
+	/* measure rendering without window */
+	if(cmd_benchmark->getValue() > 0){
+		zer0::init("Sphere Mesh Approximation", false);
+		zer0::LOG->setAsync(cmd_async_log->getValue());
+		Benchmark * benchmark = new Benchmark();
+		bool ok = zer0::FW->createOffscreen(cmd_window_w->getValue(), cmd_window_h->getValue()) &&
+				benchmark->init(cmd_model->getValue(), cmd_spheres->getValue(), cmd_segments->getValue());
+		if(ok){
+			benchmark->run(cmd_benchmark->getValue());
+		}
+		else{
+			zer0::ERROR("Benchmark initialization failed!");
+		}
+		delete(benchmark);
+		zer0::shutdown();
+		return ok ? 0 : 2;
+	}
 
 	/* initialize zer0engine */
 	zer0::init("Sphere Mesh Approximation");
+	zer0::LOG->setAsync(cmd_async_log->getValue());
 
 	/* create window */
 	if(!zer0::FW->createWindow(
@@ -78,9 +191,11 @@ int main(int argc, char ** argv){
 		return 2;
 	}
 
+	zer0::FW->setPrintStatistics(cmd_stats->getValue());
+
 	/* creating and run main application */
 	ModelViewer * app = new ModelViewer();
-	if(app->init(cmd_model->getValue(), cmd_spheres->getValue())){
+	if(app->init(cmd_model->getValue(), cmd_spheres->getValue(), cmd_snapshot_interval->getValue())){
 		zer0::FW->run(app);
 	}
 	else{
@@ -6,16 +6,23 @@ using namespace zer0;
 
 void Camera::upload()
 {
-	Matrix4 m, rx, ry;
+	Matrix4 m;
+	getViewMatrix(m);
+	SHADER->setViewMatrix(m);
+}
+
+void Camera::getViewMatrix(Matrix4 & m)const
+{
+	Matrix4 rx, ry;
 	m.setTranslation(-_pos);
 	rx.setRotationX(_rotation.x);
 	ry.setRotationY(_rotation.y);
-	SHADER->setViewMatrix(m*rx*ry);
+	m = m*rx*ry;
 }
 
 void Camera::mouseRotate(int rel_x, int rel_y)
 {
-	_rotation += Vector2D(rel_y, rel_x)*_rotFactor;
+	rotate(rel_y*_rotFactor, rel_x*_rotFactor);
 }
 
 void Camera::mouseTranslate(int rel_x, int rel_y)
@@ -18,12 +18,18 @@ public:
 	
 	void mouseRotate(int rel_x, int rel_y);
 
+	/* rotate around x axis (pitch) and y axis (yaw) by given angles in radians */
+	void rotate(float angle_x, float angle_y){_rotation += Vector2D(angle_x, angle_y);}
+
 	void mouseZoom(int wheel);
 
 	void mouseTranslate(int rel_x, int rel_y);
 	
 	/* calculate matrix and upload to view matrix in shader */
 	void upload();
+
+	/* calculate view matrix without uploading it */
+	void getViewMatrix(Matrix4 & m)const;
 private:
 	float _rotFactor, _zoomFactor, _translateFactor;
 	Vector2D _rotation;	
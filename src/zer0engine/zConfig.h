@@ -25,7 +25,7 @@ namespace zer0{
 
 		friend class Framework;
 
-		friend void init(const char * app_name);// see declaration in zFramework.cpp
+		friend void init(const char * app_name, bool video);// see declaration in zFramework.cpp
 	private:
 		ConfigAttributes _config;
 	};
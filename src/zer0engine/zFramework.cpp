@@ -2,11 +2,12 @@
  */
 
 #include "zFramework.h"
+#include <cstring>
 
 using namespace zer0;
 
 // init
-void zer0::init(const char * app_name)
+void zer0::init(const char * app_name, bool video)
 {
 	// create singleton framework object
 	Logger::create();
@@ -15,7 +16,7 @@ void zer0::init(const char * app_name)
 	Config::create();
 
 	// initialize framework
-	Framework::getInstance()->init(app_name);
+	Framework::getInstance()->init(app_name, video);
 }
 
 // shutdown
@@ -26,19 +27,23 @@ void zer0::shutdown()
 	Logger::destroy();
 }
 
-Framework::Framework() : _viewportMode(VIEW_NORMAL), _renderOnChange(false), _renderRequest(true), _desiredFPS(60), _measuredFPS(0.0), _deltaTime(0)
+Framework::Framework() : _mainWindow(NULL), _ownsVideo(false), _offscreenFramebuffer(0), _offscreenColorBuffer(0), _offscreenDepthBuffer(0), _viewportMode(VIEW_NORMAL), _renderOnChange(false), _renderRequest(true), _wakeUpEventType(SDL_USEREVENT), _desiredFPS(60), _measuredFPS(0.0), _deltaTime(0), _printStatistics(false)
 {
 }
 
-void Framework::init(const char * app_name)
+void Framework::init(const char * app_name, bool video)
 {
 	INFO("\nInitializing framework:");
 	//initialize SDL
 	INFO("-> SDL2");
-	if (SDL_Init(SDL_INIT_VIDEO) < 0){
+	if (SDL_Init(video ? SDL_INIT_VIDEO : 0) < 0){
 		ERROR("Failed to initialize SDL: %s", SDL_GetError());
 		exit(1);
 	}
+	_wakeUpEventType = SDL_RegisterEvents(1);
+	if(_wakeUpEventType == (Uint32)-1){
+		_wakeUpEventType = SDL_USEREVENT;
+	}
 
 	// set app name globally
 	Config::getInstance()->_config.APP_NAME = app_name;
@@ -50,6 +55,15 @@ Framework::~Framework(){
 	// free default texture
 	Texture2D::freeDefaultTextures();
 
+	if(_offscreenFramebuffer != 0){
+		glDeleteFramebuffers(1, &_offscreenFramebuffer);
+		glDeleteRenderbuffers(1, &_offscreenColorBuffer);
+		glDeleteRenderbuffers(1, &_offscreenDepthBuffer);
+	}
+	if(_ownsVideo){
+		SDL_VideoQuit();
+	}
+
 	// quit SDL
 	SDL_Quit();
 }
@@ -134,7 +148,11 @@ bool Framework::createWindow(int window_w, int window_h, int multisamples, bool
 	// init glew
 	glewExperimental = GL_TRUE;// support experimental drivers
 	GLenum glew_res = glewInit();
-	if (glew_res != GLEW_OK){
+	if(glew_res == GLEW_ERROR_NO_GLX_DISPLAY){
+		// context was not created through GLX (e.g. EGL of the offscreen video driver), the core functions are loaded nevertheless
+		WARNING("GLEW: No GLX display, GLX extensions are not available.");
+	}
+	else if (glew_res != GLEW_OK){
 		ERROR("Error while initializing GLEW: %s", (const char *)glewGetErrorString(glew_res));
 		return false;
 	}
@@ -187,6 +205,49 @@ bool Framework::createWindow(int window_w, int window_h, int multisamples, bool
 	return true;
 }
 
+bool Framework::createOffscreen(int w, int h)
+{
+	if(!SDL_WasInit(SDL_INIT_VIDEO)){
+		INFO("-> SDL2 video (offscreen)");
+		if(SDL_VideoInit("offscreen") != 0){
+			WARNING("Offscreen video driver not available (%s), using default video driver.", SDL_GetError());
+			if(SDL_VideoInit(NULL) != 0){
+				ERROR("Failed to initialize SDL video: %s", SDL_GetError());
+				return false;
+			}
+		}
+		_ownsVideo = true;
+	}
+	if(!createWindow(w, h, 0, false, false, true)){
+		return false;
+	}
+
+	// the framebuffer of a hidden window is not guaranteed to keep its pixels, so a framebuffer object is rendered to instead
+	if(glGenFramebuffers == NULL){
+		WARNING("Framebuffer objects not supported, rendering to hidden window.");
+		return true;
+	}
+	glGenRenderbuffers(1, &_offscreenColorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, _offscreenColorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+	glGenRenderbuffers(1, &_offscreenDepthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, _offscreenDepthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &_offscreenFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, _offscreenFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _offscreenColorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _offscreenDepthBuffer);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE){
+		ERROR("Offscreen framebuffer incomplete (0x%x).", status);
+		return false;
+	}
+	// framebuffer stays bound for drawing and reading
+	return true;
+}
+
 void Framework::showWindow()
 {
 	SDL_ShowWindow(_mainWindow);
@@ -201,6 +262,7 @@ void Framework::run(Application * app)
 	_frameCount = 0;
 	_measuredFPS = 0;
 	Uint32 last_ticks = SDL_GetTicks();
+	Mesh::getStatistics().reset();
 	// trigger initial resize event
 	app->eventWindowResized(_windowW, _windowH);
 	while(1){
@@ -252,45 +314,45 @@ void Framework::run(Application * app)
 			return;
 
 		// rendering
-		if(!_renderOnChange || _renderRequest){
-			glClear(_clearMask);
-			switch(_viewportMode){
-			case VIEW_VSPLIT:
-				glViewport(0,0, _windowW/2, _windowH);
-				app->render(1);
-				glViewport(_windowW/2, 0, _windowW/2, _windowH);
-				app->render(2);
-				glClear(GL_DEPTH_BUFFER_BIT);
-			break;
-			case VIEW_HSPLIT:
-				glViewport(0,0, _windowW, _windowH/2);
-				app->render(1);
-				glViewport(0, _windowH/2, _windowW, _windowH/2);
-				app->render(2);
-				glClear(GL_DEPTH_BUFFER_BIT);
-			break;
-			}
-			glViewport(0, 0, _windowW, _windowH);
-			app->render(0);
+		bool rendered = !_renderOnChange || _renderRequest;
+		if(rendered){
+			renderFrame(app);
 
 			// swap buffer
 			SDL_GL_SwapWindow(_mainWindow);
 
+			// everything counted since the last rendered frame belongs to this one
+			_frameStatistics = Mesh::getStatistics();
+			Mesh::getStatistics().reset();
+
 			_renderRequest = false;
 		}
 		// const fps delay
 		Uint32 render_time = SDL_GetTicks()-last_ticks;
 		int frametime = 1000/_desiredFPS;
 		int delay = frametime-render_time;
-		if(delay > 0)
+		if(_renderOnChange && !rendered){
+			// nothing to do, sleep until input arrives, it is handled and rendered in the next cycle without delay
+			SDL_WaitEventTimeout(NULL, ZER0_IDLE_WAIT_TIMEOUT);
+		}
+		else if(delay > 0){
 			SDL_Delay((Uint32)delay);
+		}
 
-		_frameCount++;
+		// only rendered frames count, idle cycles of render-on-change are not frames
+		if(rendered){
+			_frameCount++;
+		}
 
 		Uint32 ticks_now = SDL_GetTicks();
 		if(ticks_now/ZER0_FRAME_MEASURE_INTERVAL != last_ticks/ZER0_FRAME_MEASURE_INTERVAL)
 		{
 			_measuredFPS = _frameCount*1000.0f/(ticks_now-_lastFrameMeasureTime);
+			if(_printStatistics && _frameCount > 0){
+				const RenderStatistics & s = _frameStatistics;
+				INFO("FPS: %.1f | last frame: %lu draw calls, %lu binds, %lu vertices, %lu indices, %lu triangles, %lu bytes uploaded, %lu buffer allocations",
+					_measuredFPS, s.drawCalls, s.binds, s.vertices, s.indices, s.triangles, s.uploadedBytes, s.bufferAllocations);
+			}
 			_lastFrameMeasureTime = ticks_now;
 			_frameCount = 0;
 		}
@@ -301,6 +363,37 @@ void Framework::run(Application * app)
 	}
 }
 
+void Framework::renderFrame(Application * app)
+{
+	glClear(_clearMask);
+	switch(_viewportMode){
+	case VIEW_VSPLIT:
+		glViewport(0,0, _windowW/2, _windowH);
+		app->render(1);
+		glViewport(_windowW/2, 0, _windowW/2, _windowH);
+		app->render(2);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	break;
+	case VIEW_HSPLIT:
+		glViewport(0,0, _windowW, _windowH/2);
+		app->render(1);
+		glViewport(0, _windowH/2, _windowW, _windowH/2);
+		app->render(2);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	break;
+	}
+	glViewport(0, 0, _windowW, _windowH);
+	app->render(0);
+}
+
+void Framework::wakeUp()
+{
+	SDL_Event e;
+	memset(&e, 0, sizeof(e));
+	e.type = _wakeUpEventType;
+	SDL_PushEvent(&e);
+}
+
 void Framework::setRenderMode(RenderMode mode, Shader * shader)
 {
 	switch(mode)
@@ -10,6 +10,7 @@
 #include "zLogger.h"
 #include "zTexture.h"
 #include "zShader.h"
+#include "zMesh.h"
 #include "zConfig.h"
 #include "zRect.h"
 
@@ -17,6 +18,7 @@
 #define FW Framework::getInstance()
 
 #define ZER0_FRAME_MEASURE_INTERVAL 1000 //ms
+#define ZER0_IDLE_WAIT_TIMEOUT 500 //ms, longest time the main loop sleeps without update() when rendering on change
 
 namespace zer0{
 
@@ -24,8 +26,10 @@ namespace zer0{
 	/**
 	 * Initializes the engine. This function must be called before using any other.
 	 * Creates singleton objects and initializes logger class.
+	 * @param video If set to false the SDL video subsystem is not initialized (no window can be created),
+	 *  e.g. for processing models on machines without a display.
 	 */
-	void init(const char * app_name);
+	void init(const char * app_name, bool video = true);
 
 	/**
 	 * Shuts down framework. Releases all memory allocated by engine and quits SDL.
@@ -89,6 +93,15 @@ namespace zer0{
 			bool createWindow(int window_w = 800, int window_h = 600, int multisamples = 0,
 								bool fullscreen = false, bool vsync = false, bool hidden = false);
 
+			/**
+			 * Create a hidden window whose OpenGL context renders into a framebuffer object of given size, e.g. to write images with a PixelReader.
+			 * Without a video subsystem (see init()) the SDL 'offscreen' video driver (EGL pbuffer, SDL >= 2.0.12) is tried first,
+			 * so no display is needed, the default video driver is used if it is not available.
+			 * Frames are rendered with renderFrame() instead of run().
+			 * @return True on success, false on error.
+			 */
+			bool createOffscreen(int w, int h);
+
 			/**
 			 * show the window when hidden=true was passed to createWindow()
 			 */
@@ -96,10 +109,18 @@ namespace zer0{
 
 			/**
 			 * Running main loop with callbacks to given application.
+			 * If render-on-change is active and nothing has to be rendered, the loop sleeps until an event arrives (see wakeUp()),
+			 * events are handled and rendered immediately then. The frame rate is limited to the desired fps while rendering.
 			 * @param app The application to run
 			 */
 			void run(Application * app);
 
+			/**
+			 * Render all viewports of given application once without swapping buffers (called by run()),
+			 * renders into the framebuffer object if the context was created with createOffscreen().
+			 */
+			void renderFrame(Application * app);
+
 			/**
 			 * set whether rendering a new frame only happens on change signaled by the application
 			 * @param b if set to true new frame is only drawn on change
@@ -111,6 +132,12 @@ namespace zer0{
 			 */
 			void renderRequest(){_renderRequest = true;}
 
+			/**
+			 * wake up main loop waiting for events, so update() is called as soon as possible (e.g. when a background thread has new results)
+			 * NOTE: can be called from any thread
+			 */
+			void wakeUp();
+
 			enum ViewPortMode{	VIEW_NORMAL, /* normal, one viewport covers whole window */
 								VIEW_VSPLIT, /* two viewports, window is split vertically */
 								VIEW_HSPLIT  /* two viewports, window is split horizontally */
@@ -120,6 +147,22 @@ namespace zer0{
 			 */
 			void setViewportMode(ViewPortMode v){_viewportMode = v;}
 
+			/**
+			 * get number of frames per second rendered by run(), measured over the last ZER0_FRAME_MEASURE_INTERVAL
+			 */
+			float getMeasuredFPS(){return _measuredFPS;}
+
+			/**
+			 * get draw calls, uploads etc. of the last frame rendered by run() (see Mesh::getStatistics()),
+			 * uploads between two rendered frames (e.g. in update()) are counted for the later frame
+			 */
+			const RenderStatistics & getFrameStatistics(){return _frameStatistics;}
+
+			/**
+			 * log measured fps and statistics of the last frame every ZER0_FRAME_MEASURE_INTERVAL while run() is rendering
+			 */
+			void setPrintStatistics(bool b){_printStatistics = b;}
+
 			/**
 			 * get window size
 			 */	
@@ -163,26 +206,33 @@ namespace zer0{
 	
 			/*** friends ***/
 			// init and shutdown are declared as friends in order to provide access to the private singleton object
-			friend void init(const char * app_name);
+			friend void init(const char * app_name, bool video);
 			friend void shutdown();
 		private:
 			/* intialize SDL and program paths 
 			 * called by init()
 			 */
-			void init(const char* app_name);
+			void init(const char* app_name, bool video);
 
 			GLbitfield _clearMask;
 			int _windowW;
 			int _windowH;
 			SDL_Window * _mainWindow;
+			bool _ownsVideo;// video subsystem was initialized by createOffscreen()
+			GLuint _offscreenFramebuffer;
+			GLuint _offscreenColorBuffer;
+			GLuint _offscreenDepthBuffer;
 			GLuint _defaultVAO;
 			int _desiredFPS;
 			float _measuredFPS;
 			int _frameCount;
 			Uint32 _lastFrameMeasureTime;
 			Uint32 _deltaTime;
+			RenderStatistics _frameStatistics;
+			bool _printStatistics;
 			bool _renderOnChange;
 			bool _renderRequest;
+			Uint32 _wakeUpEventType;// user event pushed by wakeUp()
 			ViewPortMode _viewportMode;
 	};
 
@@ -0,0 +1,22 @@
+/* Author: Cornelius Marx
+ */
+#include "zFrustum.h"
+
+using namespace zer0;
+
+void Frustum::set(const Matrix4 & m)
+{
+	// a point p is inside if -w <= x,y,z <= w for (x,y,z,w) = m*p, so every plane is the last row plus/minus another row
+	Vector4D r[4] = {m.getRow(0), m.getRow(1), m.getRow(2), m.getRow(3)};
+	for(int i = 0; i < 3; i++){
+		_planes[2*i].set(r[3].x + r[i].x, r[3].y + r[i].y, r[3].z + r[i].z, r[3].w + r[i].w);
+		_planes[2*i+1].set(r[3].x - r[i].x, r[3].y - r[i].y, r[3].z - r[i].z, r[3].w - r[i].w);
+	}
+	// normalized planes give the signed distance, which is compared to the radius of bounding spheres
+	for(Vector4D & p : _planes){
+		float length = p.getVector3D().getLength();
+		if(length > 0){
+			p.set(p.x/length, p.y/length, p.z/length, p.w/length);
+		}
+	}
+}
@@ -0,0 +1,47 @@
+/* Author: Cornelius Marx
+ */
+#ifndef ZER0_FRUSTUM_H
+#define ZER0_FRUSTUM_H
+
+#include "zMatrix4.h"
+#include "zVector4D.h"
+
+namespace zer0{
+
+	/**
+	 * View frustum given by 6 planes, used to skip objects that are not visible.
+	 */
+	class Frustum
+	{
+	public:
+		Frustum(){}
+
+		/* see set() */
+		explicit Frustum(const Matrix4 & m){set(m);}
+
+		/**
+		 * Extract planes from a projection matrix (Gribb/Hartmann).
+		 * @param m projection*view*model, objects are tested in the space m transforms from (e.g. model space)
+		 */
+		void set(const Matrix4 & m);
+
+		/**
+		 * Conservative visibility test of a bounding sphere.
+		 * @return false if the sphere lies completely outside of the frustum
+		 */
+		bool intersectsSphere(const Vector3D & center, float radius)const{
+			for(int i = 0; i < 6; i++){
+				const Vector4D & p = _planes[i];
+				if(p.x*center.x + p.y*center.y + p.z*center.z + p.w < -radius){
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		Vector4D _planes[6];// left, right, bottom, top, near, far: normal (xyz, unit length, pointing inside) and distance (w)
+	};
+};
+
+#endif
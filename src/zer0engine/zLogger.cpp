@@ -1,4 +1,6 @@
 #include "zer0engine.h"
+#include <vector>
+#include <cstring>
 
 using namespace zer0;
 
@@ -6,10 +8,15 @@ Logger::Logger()
 {
 	_logfile = NULL;
 	_std_print = true;
+	_async = false;
+	_stopWriter = false;
+	_numPushed = 0;
+	_numWritten = 0;
 }
 
 Logger::~Logger()
 {
+	setAsync(false);
 	closeLog();
 }
 
@@ -24,6 +31,56 @@ void Logger::createLog(bool std_print, const char * logfile_path)
 	}
 }
 
+void Logger::setAsync(bool async)
+{
+	if(async == _async){
+		return;
+	}
+	if(async){
+		_stopWriter = false;
+		_writerThread = std::thread(&Logger::asyncWriter, this);
+		_async = true;
+	}
+	else{
+		// background thread writes all pending records before it quits
+		_async = false;
+		_stopWriter = true;
+		_writerCondition.notify_one();
+		_writerThread.join();
+	}
+}
+
+void Logger::flush()
+{
+	if(!_async){
+		return;
+	}
+	size_t pushed = _numPushed.load();
+	while(_numWritten.load() < pushed){
+		_writerCondition.notify_one();
+		std::this_thread::yield();
+	}
+}
+
+void Logger::asyncWriter()
+{
+	Record r;
+	while(1){
+		if(_queue.pop(r)){
+			writeText(r.mode, r.text);
+			_numWritten++;
+		}
+		else if(_stopWriter){
+			// queue is empty, no more records to write
+			break;
+		}
+		else{// queue empty -> wait for new records
+			std::unique_lock<std::mutex> lock(_writerMutex);
+			_writerCondition.wait_for(lock, std::chrono::milliseconds(10));
+		}
+	}
+}
+
 void Logger::printfMode(enum Mode mode, bool new_line, const char * fmt, ...)
 {
 	va_list arg_list;
@@ -34,73 +91,109 @@ void Logger::printfMode(enum Mode mode, bool new_line, const char * fmt, ...)
 
 void Logger::printfMode(enum Mode mode, bool new_line, const char * fmt, va_list args)
 {
-	_currentMode = mode;
+	Record r;
+	r.mode = mode;
+	int len = 0;
 	// printing prefix
 	switch(mode)
 	{
+	case LOG_VERBOSE:
 	case LOG_INFO:
 	break;
 	case LOG_WARNING:
-		printFormatted("WARNING: ");
+		len = snprintf(r.text, sizeof(r.text), "WARNING: ");
 	break;
 	case LOG_ERROR:
-		printFormatted("ERROR: ");
+		len = snprintf(r.text, sizeof(r.text), "ERROR: ");
 	break;
 	default:
 		printf("<unknown log mode %d>\n", (int)mode);
 		return;
 	}
 
-	// printing actual formatted text
-	printFormatted(fmt, args);
+	// printing actual formatted text, leaving space for the new line
+	const int max_len = sizeof(r.text)-2;
+	va_list args_copy;
+	va_copy(args_copy, args);
+	int text_len = vsnprintf(r.text+len, max_len-len+1, fmt, args);
+	if(text_len < 0){
+		va_end(args_copy);
+		return;
+	}
+	if(len + text_len > max_len){
+		// statement does not fit into a record, format again with enough space and write it directly
+		std::vector<char> text(len + text_len + 2);
+		memcpy(text.data(), r.text, len);
+		vsnprintf(text.data()+len, text_len+1, fmt, args_copy);
+		va_end(args_copy);
+		len += text_len;
+		if(new_line){
+			text[len++] = '\n';
+		}
+		text[len] = '\0';
+		// records pushed so far by this thread have to be written first
+		flush();
+		writeText(mode, text.data());
+		return;
+	}
+	va_end(args_copy);
+	len += text_len;
 
 	// print a new line
 	if(new_line){
-		writeLines(1);
+		r.text[len++] = '\n';
+		r.text[len] = '\0';
 	}
 
+	if(_async){
+		// wait for the background thread to free a slot if queue is full
+		while(!_queue.push(r)){
+			_writerCondition.notify_one();
+			std::this_thread::yield();
+		}
+		_numPushed++;
+		_writerCondition.notify_one();
+	}
+	else{
+		writeText(r.mode, r.text);
+	}
 }
 
-void Logger::printFormatted(const char * fmt, ...)
-{
-	va_list arg_list;
-	va_start(arg_list, fmt);
-	printFormatted(fmt, arg_list);
-	va_end(arg_list);
-}
-
-void Logger::printFormatted(const char * fmt, va_list args)
+void Logger::writeText(Mode mode, const char * text)
 {
+	// printing to logfile if active
 	if(_logfile){
-		va_list args_copy;
-		va_copy(args_copy, args);
-		// printing to logfile if active
-		vfprintf(_logfile, fmt, args_copy);
+		fputs(text, _logfile);
 		fflush(_logfile);
-		va_end(args_copy);
 	}
 
 	// printing to stdout if active
 	if(_std_print) {
 		FILE * out = stdout;
-		if(_currentMode == LOG_ERROR)
+		if(mode == LOG_ERROR)
 			out = stderr;
-		vfprintf(out, fmt, args);
+		fputs(text, out);
 		fflush(out);
 	}
 }
 
-void Logger::writeLines(int num)
+void Logger::printFormatted(const char * fmt, ...)
 {
-	if(_std_print){
-		for(int i = 0; i < num; i++)
-			puts("");
-	}
+	va_list arg_list;
+	va_start(arg_list, fmt);
+	printFormatted(fmt, arg_list);
+	va_end(arg_list);
+}
 
-	if(_logfile){
-		for(int i = 0; i < num; i++)
-			fputs("\n", _logfile);
-	}
+void Logger::printFormatted(const char * fmt, va_list args)
+{
+	printfMode(LOG_INFO, false, fmt, args);
+}
+
+void Logger::writeLines(int num)
+{
+	for(int i = 0; i < num; i++)
+		printFormatted("\n");
 }
 
 void Logger::closeLog()
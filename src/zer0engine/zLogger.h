@@ -5,20 +5,61 @@
 
 #include <cstdarg>
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "zSingleton.h"
+#include "zRingBuffer.h"
 
 #define LOG Logger::getInstance()
-/* logging macros */
-#define INFO(X, ...) LOG->printfMode(zer0::Logger::LOG_INFO, true, X, ##__VA_ARGS__)
-#define WARNING(X, ...) LOG->printfMode(zer0::Logger::LOG_WARNING, true, X, ##__VA_ARGS__)
-#define ERROR(X, ...) LOG->printfMode(zer0::Logger::LOG_ERROR, true, X, ##__VA_ARGS__)
+
+/* compile-time log levels, statements below ZER0_LOG_LEVEL are removed by the preprocessor */
+#define ZER0_LOG_LEVEL_VERBOSE 0
+#define ZER0_LOG_LEVEL_INFO    1
+#define ZER0_LOG_LEVEL_WARNING 2
+#define ZER0_LOG_LEVEL_ERROR   3
+#ifndef ZER0_LOG_LEVEL
+	#ifdef NDEBUG
+		#define ZER0_LOG_LEVEL ZER0_LOG_LEVEL_INFO
+	#else
+		#define ZER0_LOG_LEVEL ZER0_LOG_LEVEL_VERBOSE
+	#endif
+#endif
+
+/* max length of a log statement that is passed through the async queue in bytes (longer statements are written directly) */
+#define ZER0_LOG_RECORD_SIZE 512
+/* number of records the async log queue can hold before producers have to wait */
+#define ZER0_LOG_QUEUE_SIZE 1024
+
+/* logging macros, arguments of removed statements are not evaluated */
+#if ZER0_LOG_LEVEL <= ZER0_LOG_LEVEL_VERBOSE
+	#define VERBOSE(X, ...) LOG->printfMode(zer0::Logger::LOG_VERBOSE, true, X, ##__VA_ARGS__)
+#else
+	#define VERBOSE(X, ...) Logger::noop()
+#endif
+#if ZER0_LOG_LEVEL <= ZER0_LOG_LEVEL_INFO
+	#define INFO(X, ...) LOG->printfMode(zer0::Logger::LOG_INFO, true, X, ##__VA_ARGS__)
+#else
+	#define INFO(X, ...) Logger::noop()
+#endif
+#if ZER0_LOG_LEVEL <= ZER0_LOG_LEVEL_WARNING
+	#define WARNING(X, ...) LOG->printfMode(zer0::Logger::LOG_WARNING, true, X, ##__VA_ARGS__)
+#else
+	#define WARNING(X, ...) Logger::noop()
+#endif
+#if ZER0_LOG_LEVEL <= ZER0_LOG_LEVEL_ERROR
+	#define ERROR(X, ...) LOG->printfMode(zer0::Logger::LOG_ERROR, true, X, ##__VA_ARGS__)
+#else
+	#define ERROR(X, ...) Logger::noop()
+#endif
 
 namespace zer0{
 	class Logger : public Singleton<Logger>
 	{
 	public:
 		// logging modes
-		enum Mode{LOG_INFO, LOG_WARNING, LOG_ERROR};
+		enum Mode{LOG_VERBOSE, LOG_INFO, LOG_WARNING, LOG_ERROR};
 
 		/**
 		 * constructor
@@ -26,11 +67,11 @@ namespace zer0{
 		Logger();
 
 		/**
-		 * destructor 
-		 * External log file is closed.
+		 * destructor
+		 * Pending records are written and external log file is closed.
 		 */
 		~Logger();
-		
+
 		/**
 		 * initializer
 		 * @param std_print Enable printing to stdout/stderr.
@@ -38,6 +79,20 @@ namespace zer0{
 		 */
 		void createLog(bool std_print, const char * logfile);
 
+		/**
+		 * Enable/disable asynchronous logging.
+		 * In async mode statements are formatted by the calling thread and pushed into a lock-free queue,
+		 * a background thread writes them to stdout/logfile. Disabling waits for all pending records to be written.
+		 * Statements longer than ZER0_LOG_RECORD_SIZE do not fit into a record, the calling thread waits for the queue
+		 * to be written and writes them itself.
+		 */
+		void setAsync(bool async);
+		bool isAsync()const{return _async;}
+
+		/**
+		 * Block until every record pushed so far has been written (only has an effect in async mode).
+		 */
+		void flush();
 
 		/**
 		 * Log statements on given mode.
@@ -57,24 +112,50 @@ namespace zer0{
 		#endif
 		void printFormatted(const char * fmt, ...);
 
-		/* 
+		/*
 		 * Writing out given number of linebreaks to all registered streams
 		 * @param num number of linebreaks to write
 		 */
 		void writeLines(int num);
 
+		/*
+		 * Stand-in for logging statements removed at compile-time (see ZER0_LOG_LEVEL)
+		 */
+		static void noop(){}
+
 		/*** friends ***/
 		// init and shutdown are declared as friends in order to provide access to the private singleton object
-		friend void init(const char * app_name);
+		friend void init(const char * app_name, bool video);
 		friend void shutdown();
 	private:
+		/* single formatted log statement */
+		struct Record{
+			Mode mode;
+			char text[ZER0_LOG_RECORD_SIZE];
+		};
+
 		/* close external log file if it was opened on createLog()
 		 */
 		void closeLog();
 
+		/* write formatted text to all registered streams */
+		void writeText(Mode mode, const char * text);
+
+		/* main function of background thread in async mode */
+		void asyncWriter();
+
 		FILE * _logfile;
 		bool _std_print; //shall the output be written to console? (std)
-		Mode _currentMode;
+
+		/* async mode */
+		std::atomic<bool> _async;
+		RingBuffer<Record, ZER0_LOG_QUEUE_SIZE> _queue;
+		std::thread _writerThread;
+		std::atomic<bool> _stopWriter;
+		std::atomic<size_t> _numPushed;  // records pushed to queue
+		std::atomic<size_t> _numWritten; // records written by background thread
+		std::mutex _writerMutex;         // only used for waiting on _writerCondition
+		std::condition_variable _writerCondition;
 	};
 
 };
@@ -1,9 +1,14 @@
 /* Author: Cornelius Marx
  */
 #include "zMesh.h"
+#include "zMeshOptimizer.h"
+#include <cstring>
+#include <algorithm>
 
 using namespace zer0;
 
+RenderStatistics Mesh::_statistics;
+
 void Mesh::loadPrimitive(Primitive p, const Vector3D & dim, int segments, bool smooth)
 {
 	clear();
@@ -194,18 +199,17 @@ void Mesh::loadPrimitive(Primitive p, const Vector3D & dim, int segments, bool s
 	assert(total_vertex_size > 0);
 
 	// put vertices in buffer
-	glGenBuffers(1, &_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, _buffer);
-	glBufferData(GL_ARRAY_BUFFER, total_vertex_size, vertices, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	uploadBuffer(GL_ARRAY_BUFFER, _buffer, _bufferCapacity, vertices, total_vertex_size);
 
 	// put indices in buffer
 	if(_elementCount > 0){
 		assert(total_index_size > 0);
-		glGenBuffers(1, &_elementBuffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _elementBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, total_index_size, indices, GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		if(_elementType == GL_UNSIGNED_INT){
+			setElements((const GLuint*)indices, _elementCount, _vertexCount);
+		}
+		else{
+			uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, _elementBuffer, _elementBufferCapacity, indices, total_index_size);
+		}
 	}
 	delete[](vertices);
 	delete[](indices);
@@ -233,45 +237,178 @@ void Mesh::generateCircleData(float radius, Vector2D * v, int segments, const Ve
 
 void Mesh::clear()
 {
-	glDeleteBuffers(1, &_buffer);
+	// attribute setup refers to the deleted buffers
+	clearVertexArrays();
+	if(!_sharedBuffer){
+		glDeleteBuffers(1, &_buffer);
+	}
 	glDeleteBuffers(1, &_elementBuffer);
 	_buffer=0;
+	_sharedBuffer = false;
 	_vertexCount = 0;
 	_elementCount = 0;
 	_elementBuffer=0;
+	_bufferCapacity = 0;
+	_elementBufferCapacity = 0;
+	_quantized = false;
+}
+
+void Mesh::clearVertexArrays()
+{
+	for(VertexArray & va : _vertexArrays){
+		glDeleteVertexArrays(1, &va.vao);
+	}
+	_vertexArrays.clear();
 }
 
 void Mesh::bind(GLubyte flags){
 	if(_vertexCount == 0){
 		return;
 	}
-	int offset = _numDimensions*_vertexCount;
+	_statistics.binds++;
+	// quantized components are decoded by the shader
+	if(_quantized){
+		SHADER->setVertexDecode(_positionOffset, _positionScale, (_flags & NORMAL) != 0);
+	}
+	else{
+		SHADER->resetVertexDecode();
+	}
+	if(!CONFIG.SUPPORTS_NEW_GL){
+		setAttributePointers(flags);
+		return;
+	}
+
+	// look for vertex array object recorded with the same attribute locations
+	flags &= _flags;
+	GLint locations[4] = {SHADER->getVertexLocation(), SHADER->getNormalLocation(), SHADER->getUVLocation(), SHADER->getColorLocation()};
+	for(const VertexArray & va : _vertexArrays){
+		if(va.flags == flags && memcmp(va.locations, locations, sizeof(locations)) == 0){
+			glBindVertexArray(va.vao);
+			// recorded arrays replace generic attribute values (see Shader::setColor())
+			Shader::invalidateColor(locations[0]);
+			for(int i = 1; i < 4; i++){
+				if(flags & (1 << (i-1))){
+					Shader::invalidateColor(locations[i]);
+				}
+			}
+			return;
+		}
+	}
+
+	// record new one
+	VertexArray va;
+	memcpy(va.locations, locations, sizeof(locations));
+	va.flags = flags;
+	glGenVertexArrays(1, &va.vao);
+	glBindVertexArray(va.vao);
+	setAttributePointers(flags);
+	_vertexArrays.push_back(va);
+}
+
+void Mesh::setAttributePointers(GLubyte flags)
+{
 	glBindBuffer(GL_ARRAY_BUFFER, _buffer);
 
 	// set vertex pointer
-	SHADER->setVertexPointer(_numDimensions);
+	if(_quantized){
+		SHADER->setVertexPointer(3, GL_UNSIGNED_SHORT, GL_TRUE, getPositionSize(), 0);
+	}
+	else{
+		SHADER->setVertexPointer(_numDimensions);
+	}
+	size_t offset = getPositionSize()*_vertexCount;
 
 	// set normal pointer
-	if(_flags & NORMAL & flags){
-		SHADER->setNormalPointer(0, offset*sizeof(float));
-		offset +=  3*_vertexCount; //normals used -> adjust uv offset
+	if(_flags & NORMAL){
+		if(flags & NORMAL){
+			if(_quantized){
+				SHADER->setNormalPointer(2, GL_SHORT, GL_TRUE, 0, offset);
+			}
+			else{
+				SHADER->setNormalPointer(0, offset);
+			}
+		}
+		offset += getNormalSize()*_vertexCount;
 	}
 
 	// set uv pointer
-	if(_flags & UV & flags){
-		SHADER->setUVPointer(0, offset*sizeof(float));
-		offset +=  2*_vertexCount; //normals used -> adjust uv offset
+	if(_flags & UV){
+		if(flags & UV){
+			SHADER->setUVPointer(0, offset);
+		}
+		offset += 2*sizeof(float)*_vertexCount;
 	}
 
 	// set color pointer
 	if(_flags & COLOR & flags){
-		SHADER->setColorPointer(0, offset*sizeof(float));
+		SHADER->setColorPointer(0, offset);
 	}
 
 	// bind element buffer (Note: if _elementBuffer = 0 then nothing is bound)
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _elementBuffer);
 }
 
+void Mesh::uploadBuffer(GLenum target, GLuint & buffer, GLsizeiptr & capacity, const void * data, GLsizeiptr size)
+{
+	// element buffer binding is part of the vertex array object that is currently bound, upload through a target that is not
+	if(target == GL_ELEMENT_ARRAY_BUFFER && CONFIG.SUPPORTS_NEW_GL){
+		target = GL_COPY_WRITE_BUFFER;
+	}
+	if(buffer == 0){
+		glGenBuffers(1, &buffer);
+		capacity = 0;
+	}
+	glBindBuffer(target, buffer);
+	_statistics.uploadedBytes += size;
+	if(size > capacity || size*4 < capacity){
+		// grow geometrically, so slowly growing data is not reallocated on every upload, shrink if most of the storage would be unused
+		if(size > capacity && capacity > 0){
+			capacity = std::max(size, 2*capacity);
+		}
+		else{
+			capacity = size;
+		}
+		_statistics.bufferAllocations++;
+		if(capacity == size){
+			glBufferData(target, size, data, _usage);
+		}
+		else{
+			glBufferData(target, capacity, NULL, _usage);
+			glBufferSubData(target, 0, size, data);
+		}
+	}
+	else{
+		// orphan storage that might still be used by previous draw calls
+		if(_usage != GL_STATIC_DRAW){
+			glBufferData(target, capacity, NULL, _usage);
+			_statistics.bufferAllocations++;
+		}
+		glBufferSubData(target, 0, size, data);
+	}
+	glBindBuffer(target, 0);
+}
+
+void Mesh::countPrimitives(size_t count, size_t num_instances)const
+{
+	if(_elementBuffer == 0){
+		_statistics.vertices += count*num_instances;
+	}
+	else{
+		_statistics.indices += count*num_instances;
+	}
+	switch(_drawMode){
+	case GL_TRIANGLES:
+		_statistics.triangles += count/3*num_instances;
+	break;
+	case GL_TRIANGLE_STRIP:
+	case GL_TRIANGLE_FAN:
+		_statistics.triangles += count >= 3 ? (count-2)*num_instances : 0;
+	break;
+	default:// points and lines
+	break;
+	}
+}
+
 void Mesh::draw()
 {
 	if(_elementBuffer == 0){
@@ -280,61 +417,276 @@ void Mesh::draw()
 	else{
 		glDrawElements(_drawMode, _elementCount, _elementType, 0);
 	}
+	_statistics.drawCalls++;
+	countPrimitives(_elementBuffer == 0 ? _vertexCount : _elementCount);
 }
 
-void Mesh::set3D(const float * data, size_t num_verts, unsigned char components, GLenum draw_mode)
+void Mesh::drawInstanced(GLsizei num_instances)
+{
+	if(_elementBuffer == 0){
+		glDrawArraysInstanced(_drawMode, 0, _vertexCount, num_instances);
+	}
+	else{
+		glDrawElementsInstanced(_drawMode, _elementCount, _elementType, 0, num_instances);
+	}
+	_statistics.drawCalls++;
+	countPrimitives(_elementBuffer == 0 ? _vertexCount : _elementCount, num_instances);
+}
+
+void Mesh::drawRanges(const GLsizei * first_elements, const GLsizei * counts, GLsizei num_ranges)
+{
+	if(_elementBuffer == 0){
+		glMultiDrawArrays(_drawMode, first_elements, counts, num_ranges);
+		_statistics.drawCalls++;
+		for(GLsizei i = 0; i < num_ranges; i++){
+			countPrimitives(counts[i]);
+		}
+		return;
+	}
+	size_t element_size = (_elementType == GL_UNSIGNED_INT) ? sizeof(GLuint) : ((_elementType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLubyte));
+	std::vector<const GLvoid*> offsets(num_ranges);
+	for(GLsizei i = 0; i < num_ranges; i++){
+		offsets[i] = (const GLvoid*)(first_elements[i]*element_size);
+	}
+	glMultiDrawElements(_drawMode, counts, _elementType, offsets.data(), num_ranges);
+	_statistics.drawCalls++;
+	for(GLsizei i = 0; i < num_ranges; i++){
+		countPrimitives(counts[i]);
+	}
+}
+
+void Mesh::setVertexData(const float * data, size_t num_verts, int num_dimensions, unsigned char components, GLenum draw_mode)
 {
 	// common mistake: passing GL_LINE instead of GL_LINES
 	assert(draw_mode != GL_LINE);
-	clear();
+	bool quantized = _quantize && num_dimensions == 3;
+	// components are stored one after another, so attribute offsets recorded in vertex array objects depend on the vertex count
+	if(_vertexCount != (GLsizei)num_verts || _flags != components || _numDimensions != num_dimensions || _quantized != quantized){
+		clearVertexArrays();
+	}
+	// never write into the buffer of another mesh
+	if(_sharedBuffer){
+		clearVertexArrays();
+		_buffer = 0;
+		_bufferCapacity = 0;
+		_sharedBuffer = false;
+	}
 	_drawMode = draw_mode;
 	_flags = components;
 	_vertexCount = num_verts;
-	_numDimensions = 3;
-	glGenBuffers(1, &_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, _buffer);
-	int num_floats_per_vertex = 3;
+	_numDimensions = num_dimensions;
+	_quantized = quantized;
+	size_t vertex_size = getPositionSize();
 	if(_flags & NORMAL){
-		num_floats_per_vertex += 3;
+		vertex_size += getNormalSize();
 	}
 	if(_flags & UV){
-		num_floats_per_vertex += 2;
+		vertex_size += 2*sizeof(float);
 	}
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float)*num_floats_per_vertex*num_verts, data, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if(!_quantized){
+		uploadBuffer(GL_ARRAY_BUFFER, _buffer, _bufferCapacity, data, vertex_size*num_verts);
+		return;
+	}
+
+	// positions are stored relative to their bounding box
+	float min[3] = {0, 0, 0};
+	float max[3] = {0, 0, 0};
+	for(size_t i = 0; i < num_verts; i++){
+		for(int j = 0; j < 3; j++){
+			float v = data[3*i+j];
+			if(i == 0 || v < min[j]){
+				min[j] = v;
+			}
+			if(i == 0 || v > max[j]){
+				max[j] = v;
+			}
+		}
+	}
+	float scale[3];
+	for(int j = 0; j < 3; j++){
+		scale[j] = max[j] > min[j] ? max[j]-min[j] : 1;
+	}
+	_positionOffset.set(min[0], min[1], min[2]);
+	_positionScale.set(scale[0], scale[1], scale[2]);
+	std::vector<unsigned char> quantized_data(vertex_size*num_verts);
+	quantizeVertices(data, num_verts, quantized_data.data(), quantized_data.data() + getPositionSize()*num_verts);
+	if(_flags & UV){
+		size_t float_offset = ((_flags & NORMAL) ? 6 : 3)*num_verts;
+		size_t byte_offset = (getPositionSize() + ((_flags & NORMAL) ? getNormalSize() : 0))*num_verts;
+		memcpy(quantized_data.data() + byte_offset, data + float_offset, 2*sizeof(float)*num_verts);
+	}
+	uploadBuffer(GL_ARRAY_BUFFER, _buffer, _bufferCapacity, quantized_data.data(), quantized_data.size());
+}
+
+bool Mesh::quantizeVertices(const float * data, size_t num_verts, void * positions, void * normals)const
+{
+	bool in_range = true;
+	const float * offset = _positionOffset;
+	const float * scale = _positionScale;
+	GLushort * p = (GLushort*)positions;
+	for(size_t i = 0; i < num_verts; i++){
+		for(int j = 0; j < 3; j++){
+			float v = (data[3*i+j] - offset[j])/scale[j];
+			// tolerate rounding errors
+			if(v < -1e-5f || v > 1+1e-5f){
+				in_range = false;
+			}
+			p[4*i+j] = (GLushort)(std::min(std::max(v, 0.f), 1.f)*65535.f + 0.5f);
+		}
+		p[4*i+3] = 0;
+	}
+	if(!(_flags & NORMAL)){
+		return in_range;
+	}
+
+	// octahedral encoding: project onto octahedron |x|+|y|+|z| = 1, lower half is folded over the diagonals
+	const Vector3D * n = (const Vector3D*)(data + 3*num_verts);
+	GLshort * e = (GLshort*)normals;
+	for(size_t i = 0; i < num_verts; i++){
+		float l1 = fabs(n[i].x) + fabs(n[i].y) + fabs(n[i].z);
+		float x = 0, y = 0;
+		if(l1 > 0){
+			x = n[i].x/l1;
+			y = n[i].y/l1;
+			if(n[i].z < 0){
+				float folded_x = (1 - fabs(y))*(x >= 0 ? 1 : -1);
+				y = (1 - fabs(x))*(y >= 0 ? 1 : -1);
+				x = folded_x;
+			}
+		}
+		e[2*i+0] = (GLshort)roundf(std::min(std::max(x, -1.f), 1.f)*32767.f);
+		e[2*i+1] = (GLshort)roundf(std::min(std::max(y, -1.f), 1.f)*32767.f);
+	}
+	return in_range;
+}
+
+void Mesh::set3D(const float * data, size_t num_verts, unsigned char components, GLenum draw_mode)
+{
+	setVertexData(data, num_verts, 3, components, draw_mode);
+	// not indexed, drop element buffer of previous data
+	deleteElementBuffer();
 }
 
 void Mesh::set2D(const float * data, size_t num_verts, unsigned char components, GLenum draw_mode)
 {
-	// common mistake: passing GL_LINE instead of GL_LINES
-	assert(draw_mode != GL_LINE);
-	clear();
-	_drawMode = draw_mode;
-	_flags = components;
-	_vertexCount = num_verts;
-	_numDimensions = 2;
-	glGenBuffers(1, &_buffer);
+	setVertexData(data, num_verts, 2, components, draw_mode);
+	deleteElementBuffer();
+}
+
+void Mesh::deleteElementBuffer()
+{
+	if(_elementBuffer != 0){
+		// element buffer binding is recorded in vertex array objects
+		clearVertexArrays();
+		glDeleteBuffers(1, &_elementBuffer);
+		_elementBuffer = 0;
+		_elementBufferCapacity = 0;
+	}
+	_elementCount = 0;
+}
+
+bool Mesh::update3D(const float * data, size_t first_vertex, size_t num_verts)
+{
+	assert(_numDimensions == 3);
+	assert(first_vertex+num_verts <= (size_t)_vertexCount);
+	assert(!_sharedBuffer);
+	if(num_verts == 0){
+		return true;
+	}
+	bool in_range = true;
+	const void * positions = data;
+	const void * normals = data + 3*num_verts;
+	const float * uvs = data + ((_flags & NORMAL) ? 6 : 3)*num_verts;
+	std::vector<unsigned char> quantized_data;
+	if(_quantized){
+		quantized_data.resize((getPositionSize() + getNormalSize())*num_verts);
+		in_range = quantizeVertices(data, num_verts, quantized_data.data(), quantized_data.data() + getPositionSize()*num_verts);
+		positions = quantized_data.data();
+		normals = quantized_data.data() + getPositionSize()*num_verts;
+	}
 	glBindBuffer(GL_ARRAY_BUFFER, _buffer);
-	int num_floats_per_vertex = 2;
+	// every component is stored in its own block, so each one is written separately
+	size_t block_offset = 0;
+	glBufferSubData(GL_ARRAY_BUFFER, getPositionSize()*first_vertex, getPositionSize()*num_verts, positions);
+	_statistics.uploadedBytes += getPositionSize()*num_verts;
+	block_offset += getPositionSize()*_vertexCount;
 	if(_flags & NORMAL){
-		num_floats_per_vertex += 3;
+		glBufferSubData(GL_ARRAY_BUFFER, block_offset + getNormalSize()*first_vertex, getNormalSize()*num_verts, normals);
+		_statistics.uploadedBytes += getNormalSize()*num_verts;
+		block_offset += getNormalSize()*_vertexCount;
 	}
 	if(_flags & UV){
-		num_floats_per_vertex += 2;
+		glBufferSubData(GL_ARRAY_BUFFER, block_offset + sizeof(float)*2*first_vertex, sizeof(float)*2*num_verts, uvs);
+		_statistics.uploadedBytes += sizeof(float)*2*num_verts;
 	}
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float)*num_floats_per_vertex*num_verts, data, GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return in_range;
 }
 
 void Mesh::set3DIndexed(const float * vertex_data, size_t num_verts, const unsigned int * index_data, size_t num_indices, unsigned char components, GLenum draw_mode)
 {
-	set3D(vertex_data, num_verts, components, draw_mode);
+	std::vector<float> optimized_vertices;
+	std::vector<unsigned int> optimized_indices;
+	if(_optimizeOrder && draw_mode == GL_TRIANGLES){
+		optimized_indices.assign(index_data, index_data+num_indices);
+		optimizeTriangleOrder(optimized_indices.data(), num_indices, (const Vector3D*)vertex_data, num_verts);
+		std::vector<unsigned int> remap;
+		optimizeVertexOrder(optimized_indices.data(), num_indices, num_verts, remap);
+		// components are stored one after another, every block is reordered on its own
+		const int block_sizes[3] = {3, (components & NORMAL) ? 3 : 0, (components & UV) ? 2 : 0};
+		optimized_vertices.resize((block_sizes[0]+block_sizes[1]+block_sizes[2])*num_verts);
+		size_t offset = 0;
+		for(int size : block_sizes){
+			remapVertices(vertex_data + offset, optimized_vertices.data() + offset, num_verts, size, remap);
+			offset += size*num_verts;
+		}
+		vertex_data = optimized_vertices.data();
+		index_data = optimized_indices.data();
+	}
+	setVertexData(vertex_data, num_verts, 3, components, draw_mode);
+	// element buffer binding is recorded in vertex array objects
+	if(_elementBuffer == 0){
+		clearVertexArrays();
+	}
+	setElements(index_data, num_indices, num_verts);
+}
+
+void Mesh::setShared(const Mesh & source, const unsigned int * index_data, size_t num_indices, GLenum draw_mode)
+{
+	assert(source._numDimensions == 3 && source._buffer != 0);
+	// indices refer to the vertex order before optimization
+	assert(!source._optimizeOrder);
+	// attribute offsets depend on the layout of source, which might have changed since the last call
+	clearVertexArrays();
+	if(!_sharedBuffer){
+		glDeleteBuffers(1, &_buffer);
+	}
+	_buffer = source._buffer;
+	_bufferCapacity = 0;
+	_sharedBuffer = true;
+	_drawMode = draw_mode;
+	_flags = source._flags;
+	_vertexCount = source._vertexCount;
+	_numDimensions = source._numDimensions;
+	_quantized = source._quantized;
+	_positionOffset = source._positionOffset;
+	_positionScale = source._positionScale;
+	setElements(index_data, num_indices, _vertexCount);
+}
+
+void Mesh::setElements(const GLuint * indices, size_t num_indices, size_t num_verts)
+{
 	_elementCount = num_indices;
-	_elementType = GL_UNSIGNED_INT;
-	glGenBuffers(1, &_elementBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _elementBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*num_indices, index_data, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// use 16 bit indices if they can address every vertex
+	if(num_verts <= 0x10000){
+		_elementType = GL_UNSIGNED_SHORT;
+		std::vector<GLushort> short_indices(indices, indices+num_indices);
+		uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, _elementBuffer, _elementBufferCapacity, short_indices.data(), sizeof(GLushort)*num_indices);
+	}
+	else{
+		_elementType = GL_UNSIGNED_INT;
+		uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, _elementBuffer, _elementBufferCapacity, indices, sizeof(GLuint)*num_indices);
+	}
 }
 
 /*** constants ***/
@@ -392,12 +744,9 @@ const Vector3D zer0::CUBE_NORMALS[6] = {
 	Vector3D(0, -1, 0)
 };
 
-bool Mesh::loadOBJFromFile(const char * filename, 
-							unsigned char components,
-							std::vector<Vector3D> * vertices,
-							std::vector<unsigned int> * indices)
+/* read whole file into given string */
+static bool readFile(const char * filename, std::string & content)
 {
-	// loading whole file
 	std::ifstream f;
 	f.open(filename);
 	if(!f.good()){
@@ -412,14 +761,24 @@ bool Mesh::loadOBJFromFile(const char * filename,
 		return false;
 	}
 
-	char * buffer = new char[length+1];
-	f.read(buffer, length);
+	content.resize(length);
+	f.read(&content[0], length);
 	f.close();
-	buffer[length] = '\0';
-	bool r = loadOBJ(buffer, components, vertices, indices);
-	delete[] buffer;
+	return true;
+}
 
-	return r;
+bool Mesh::loadOBJFromFile(const char * filename, 
+							unsigned char components,
+							std::vector<Vector3D> * vertices,
+							std::vector<unsigned int> * indices)
+{
+	// loading whole file
+	std::string buffer;
+	if(!readFile(filename, buffer)){
+		return false;
+	}
+
+	return loadOBJ(buffer.c_str(), components, vertices, indices);
 }
 
 bool Mesh::loadOBJ(const char * obj, 
@@ -428,27 +787,105 @@ bool Mesh::loadOBJ(const char * obj,
 				std::vector<unsigned int> * indices)
 {
 	clear();
+	OBJData data;
+	if(!parseOBJ(obj, components, data)){
+		return false;
+	}
+	setOBJ(data);
+
+	if(vertices != nullptr){
+		vertices->insert(vertices->end(), data.vertices.begin(), data.vertices.end());
+	}
+	if(indices != nullptr){
+		indices->insert(indices->end(), data.indices.begin(), data.indices.end());
+	}
+
+	return true;
+}
+
+void Mesh::setOBJ(const OBJData & data)
+{
+	if(!_optimizeOrder){
+		uploadOBJ(data);
+		return;
+	}
+
+	OBJData optimized;
+	optimized.components = data.components;
+	optimized.elementIndices = data.elementIndices;
+	size_t num_verts = data.positions.size();
+	optimizeTriangleOrder(optimized.elementIndices.data(), optimized.elementIndices.size(), data.positions.data(), num_verts);
+	std::vector<unsigned int> remap;
+	optimizeVertexOrder(optimized.elementIndices.data(), optimized.elementIndices.size(), num_verts, remap);
+	optimized.positions.resize(num_verts);
+	remapVertices((const float*)data.positions.data(), (float*)optimized.positions.data(), num_verts, 3, remap);
+	optimized.normals.resize(data.normals.size());
+	if(!data.normals.empty()){
+		remapVertices((const float*)data.normals.data(), (float*)optimized.normals.data(), num_verts, 3, remap);
+	}
+	optimized.uvs.resize(data.uvs.size());
+	if(!data.uvs.empty()){
+		remapVertices((const float*)data.uvs.data(), (float*)optimized.uvs.data(), num_verts, 2, remap);
+	}
+	uploadOBJ(optimized);
+}
+
+void Mesh::uploadOBJ(const OBJData & data)
+{
+	clear();
+	// set element buffer
+	setElements(data.elementIndices.data(), data.elementIndices.size(), data.positions.size());
+
+	// put components one after another
+	size_t num_verts = data.positions.size();
+	std::vector<float> vertex_data((const float*)data.positions.data(), (const float*)(data.positions.data() + num_verts));
+	if(data.components & NORMAL){
+		assert(data.normals.size() == num_verts);
+		vertex_data.insert(vertex_data.end(), (const float*)data.normals.data(), (const float*)(data.normals.data() + num_verts));
+	}
+	if(data.components & UV){
+		assert(data.uvs.size() == num_verts);
+		vertex_data.insert(vertex_data.end(), (const float*)data.uvs.data(), (const float*)(data.uvs.data() + num_verts));
+	}
+	setVertexData(vertex_data.data(), num_verts, 3, data.components, GL_TRIANGLES);
+}
+
+bool Mesh::parseOBJFromFile(const char * filename, unsigned char components, OBJData & data)
+{
+	std::string buffer;
+	if(!readFile(filename, buffer)){
+		return false;
+	}
+
+	return parseOBJ(buffer.c_str(), components, data);
+}
+
+bool Mesh::parseOBJ(const char * obj, unsigned char components, OBJData & data)
+{
 	#define SKIP_WHITESPACE(L, I) while(L[I] == ' ' || L[I] == '\t'){I++;}
 	#define SKIP_NUMBER(L, I) while(L[I] >= '0' && L[I] <= '9'){I++;}
 	#define OBJ_ERROR(X, ...) ERROR(("Object file line %d: " X), line_number, ##__VA_ARGS__)
 
-	// line buffer
+	// line buffer (local, so multiple objects can be parsed concurrently)
 	static const int LINE_BUFFER_SIZE = 256;
-	static char line[LINE_BUFFER_SIZE];
-	static char face_strings[4][LINE_BUFFER_SIZE];
-	std::vector<Vector3D> * verts = vertices;
-	if(verts == nullptr){
-		verts = new std::vector<Vector3D>();
-	}
+	char line[LINE_BUFFER_SIZE];
+	char face_strings[4][LINE_BUFFER_SIZE];
+	std::vector<Vector3D> & verts = data.vertices;
+	verts.clear();
+	data.indices.clear();
 
 	std::vector<Vector3D> normals;
 	std::vector<Vector2D> uvs;
 	
 	// combined verts/normals
-	std::vector<Vector3D> comb_verts;
-	std::vector<Vector3D> comb_normals;
-	std::vector<Vector2D> comb_uvs;
-	std::vector<unsigned int> element_indices;
+	std::vector<Vector3D> & comb_verts = data.positions;
+	std::vector<Vector3D> & comb_normals = data.normals;
+	std::vector<Vector2D> & comb_uvs = data.uvs;
+	std::vector<unsigned int> & element_indices = data.elementIndices;
+	comb_verts.clear();
+	comb_normals.clear();
+	comb_uvs.clear();
+	element_indices.clear();
 	typedef std::unordered_map<std::string, unsigned int>::value_type face_verts_value_t;
 	std::unordered_map<std::string, unsigned int> face_verts;
 	bool object_found = false;
@@ -459,6 +896,7 @@ bool Mesh::loadOBJ(const char * obj,
 	int num_exp_components = 0;
 	int read_components = 0;
 	bool first_face = true;
+	GLubyte face_flags = 0;// components found in faces of file
 	while(*obj != '\0'){
 		// get next line
 		int count = 0;
@@ -509,7 +947,7 @@ bool Mesh::loadOBJ(const char * obj,
 						error = true;
 					}
 					else{
-						verts->push_back(v3);
+						verts.push_back(v3);
 					}
 				}
 				}
@@ -556,9 +994,9 @@ bool Mesh::loadOBJ(const char * obj,
 						}
 						if(first_face){// check what this face consists of
 							first_face = false;
-							_flags = flags;
+							face_flags = flags;
 						}
-						else if(_flags != flags){
+						else if(face_flags != flags){
 							OBJ_ERROR("Unexpected change in provided indices.");
 							error = true;
 							break;
@@ -567,34 +1005,32 @@ bool Mesh::loadOBJ(const char * obj,
 						v_index -=1;	
 						n_index -=1;
 						u_index -=1;	
-						if(indices != nullptr){
-							indices->push_back(v_index);
-						}
+						data.indices.push_back(v_index);
 						// try inserting
 						auto ret = face_verts.insert(face_verts_value_t(std::string(face_strings[fi]), comb_verts.size()));
 						if(ret.second){// new element
-							if(v_index < 0 || v_index >= verts->size()){
+							if(v_index < 0 || v_index >= verts.size()){
 								OBJ_ERROR("Vertex index %d out of bounds.", v_index+1);
 								error = true;
 								break;
 							}
-							else if((_flags & NORMAL) && (n_index < 0 || n_index >= normals.size())){
+							else if((face_flags & NORMAL) && (n_index < 0 || n_index >= normals.size())){
 								OBJ_ERROR("Normal index %d out of bounds.", n_index+1);
 								error = true;
 								break;
 							}
-							else if((_flags & UV) && (u_index < 0 || u_index >= uvs.size())){
+							else if((face_flags & UV) && (u_index < 0 || u_index >= uvs.size())){
 								OBJ_ERROR("UV index %d out of bounds.", u_index+1);
 								error = true;
 								break;
 							}
 							else{
 								element_indices.push_back(comb_verts.size());
-								comb_verts.push_back((*verts)[v_index]);
-								if(_flags & NORMAL){
+								comb_verts.push_back(verts[v_index]);
+								if(face_flags & components & NORMAL){
 									comb_normals.push_back(normals[n_index]);
 								}
-								if(_flags & UV){
+								if(face_flags & components & UV){
 									comb_uvs.push_back(uvs[u_index]);
 								}
 							}
@@ -621,47 +1057,10 @@ bool Mesh::loadOBJ(const char * obj,
 		line_number++;
 	}
 
-	if(!error){
-		_flags &= components;
-		// set element buffer
-		_elementCount = element_indices.size();
-		_elementType = GL_UNSIGNED_INT;
-		glGenBuffers(1, &_elementBuffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _elementBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*_elementCount, element_indices.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		
-		glGenBuffers(1, &_buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, _buffer);
-		int single_vertex_size = 3;
-		if(_flags & NORMAL){
-			single_vertex_size += 3;
-		}
-		if(_flags & UV){
-			single_vertex_size += 2;
-		}
-		_vertexCount = comb_verts.size();
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float)*single_vertex_size*_vertexCount, 0, GL_STATIC_DRAW);
-		int offset = 0;
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*3*_vertexCount, comb_verts.data());
-		offset += 3*_vertexCount;
-		if(_flags & NORMAL){
-			glBufferSubData(GL_ARRAY_BUFFER, sizeof(float)*offset, sizeof(float)*3*_vertexCount, comb_normals.data());
-			assert(comb_normals.size() == _vertexCount);
-			offset += 3*_vertexCount;
-		}
-		if(_flags & UV){
-			glBufferSubData(GL_ARRAY_BUFFER, sizeof(float)*offset, sizeof(float)*2*_vertexCount, comb_uvs.data());
-			assert(comb_uvs.size() == _vertexCount);
-		}
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		_drawMode = GL_TRIANGLES;
-		_numDimensions = 3;
-	}
-
-	if(vertices == nullptr){// no vertex list given, created locally so delete now
-		delete verts;
-	}
+	data.components = face_flags & components;
 
+	#undef SKIP_WHITESPACE
+	#undef SKIP_NUMBER
+	#undef OBJ_ERROR
 	return !error;
 }
@@ -16,6 +16,35 @@ namespace zer0{
 	extern const Vector2D QUAD_VERTS[4];
 	extern const Vector3D CUBE_VERTS[24];
 	extern const Vector3D CUBE_NORMALS[6];
+
+	/**
+	 * Work handed to the gpu through meshes, summed up over all meshes until reset() (e.g. once per frame, see Mesh::getStatistics()).
+	 * NOTE: only the thread owning the gl context may draw and upload, so the counters are not synchronized
+	 */
+	struct RenderStatistics{
+		RenderStatistics(){reset();}
+		void reset(){drawCalls = 0; binds = 0; vertices = 0; indices = 0; triangles = 0; uploadedBytes = 0; bufferAllocations = 0;}
+		/* counters accumulated between two snapshots, e.g. of a single draw function */
+		RenderStatistics operator-(const RenderStatistics & s)const{
+			RenderStatistics r;
+			r.drawCalls = drawCalls - s.drawCalls;
+			r.binds = binds - s.binds;
+			r.vertices = vertices - s.vertices;
+			r.indices = indices - s.indices;
+			r.triangles = triangles - s.triangles;
+			r.uploadedBytes = uploadedBytes - s.uploadedBytes;
+			r.bufferAllocations = bufferAllocations - s.bufferAllocations;
+			return r;
+		}
+		size_t drawCalls;
+		size_t binds;// calls to Mesh::bind()
+		size_t vertices;// vertices of non-indexed draw calls, every instance counts
+		size_t indices;// indices of indexed draw calls, every instance counts
+		size_t triangles;// triangles of all draw calls, every instance counts
+		size_t uploadedBytes;// bytes written to buffer objects
+		size_t bufferAllocations;// buffer storage (re)allocated with glBufferData(), including orphaning
+	};
+
 	/**
 	 * Mesh class represents anything that can be drawn from vertices (e.g. 3D Cube, 2D Circle, ...)
 	 */
@@ -34,13 +63,27 @@ namespace zer0{
 			/**
 			 * Constructor
 			 */
-			Mesh():_buffer(0), _elementBuffer(0), _vertexCount(0), _elementCount(0), _drawMode(GL_TRIANGLES), _numDimensions(0){};
+			Mesh():_buffer(0), _elementBuffer(0), _bufferCapacity(0), _elementBufferCapacity(0), _usage(GL_STATIC_DRAW), _sharedBuffer(false), _optimizeOrder(false), _quantize(false), _quantized(false),
+				_vertexCount(0), _elementCount(0), _drawMode(GL_TRIANGLES), _numDimensions(0){};
 
 			/**
 			 * Destructor
 			 */
 			~Mesh(){clear();};
 
+			/**
+			 * Plain vertex/index data of a wavefront object as returned by parseOBJ()
+			 */
+			struct OBJData{
+				std::vector<Vector3D> positions;// one position for every unique vertex/normal/uv combination used in faces
+				std::vector<Vector3D> normals;// normals corresponding to positions (empty if NORMAL is not in components)
+				std::vector<Vector2D> uvs;// uvs corresponding to positions (empty if UV is not in components)
+				std::vector<unsigned int> elementIndices;// 3 successive indices into positions/normals/uvs form a triangle
+				std::vector<Vector3D> vertices;// vertex positions (v) as they are listed in file
+				std::vector<unsigned int> indices;// 3 successive indices into vertices form a triangle
+				unsigned char components;// components (e.g. NORMAL, UV) that are available
+			};
+
 			/**
 			 * Loading wavefront object from file
 			 * @param filename .obj file to load
@@ -67,6 +110,26 @@ namespace zer0{
 							std::vector<Vector3D> * vertices = nullptr,
 							std::vector<unsigned int> * indices = nullptr);
 
+			/**
+			 * Parse wavefront object without uploading anything to the GPU.
+			 * This does not touch any GL state, so it is safe to call from multiple threads at once.
+			 * @param obj 0 terminated string describing the object (see loadOBJ())
+			 * @param components what components (e.g. NORMAL, UV) to load if available in file
+			 * @param data parsed vertex/index data is written to data
+			 * @return false on error, true on success
+			 */
+			static bool parseOBJ(const char * obj, unsigned char components, OBJData & data);
+
+			/**
+			 * Parse wavefront object from file without uploading anything to the GPU (see parseOBJ()).
+			 */
+			static bool parseOBJFromFile(const char * filename, unsigned char components, OBJData & data);
+
+			/**
+			 * Set vertices from parsed wavefront object data (see parseOBJ()).
+			 */
+			void setOBJ(const OBJData & data);
+
 			/**
 			 * Set vertices to represent the given primitive
 			 * @param type The primitive to load
@@ -76,6 +139,31 @@ namespace zer0{
 			 */
 			void loadPrimitive(Primitive type, const Vector3D & dim, int segments = 32, bool smooth = false);
 
+			/**
+			 * Set expected usage of the buffers for following uploads with set3D(), set2D() and set3DIndexed().
+			 * Those reuse the existing buffer storage if the new data fits, the storage grows geometrically otherwise.
+			 * With GL_DYNAMIC_DRAW or GL_STREAM_DRAW the old storage is orphaned on every upload,
+			 * so the driver does not have to wait for draw calls that are still reading from it.
+			 * @param usage GL_STATIC_DRAW (default), GL_DYNAMIC_DRAW or GL_STREAM_DRAW
+			 */
+			void setUsage(GLenum usage){_usage = usage;}
+
+			/**
+			 * Enable reordering of triangles and vertices for following uploads of indexed triangle meshes with set3DIndexed() and setOBJ()
+			 * (see optimizeTriangleOrder() and optimizeVertexOrder()), so drawing makes better use of the post-transform vertex cache,
+			 * has less overdraw and fetches vertices sequentially. The order of the given data is not preserved in the buffers.
+			 */
+			void setOptimizeOrder(bool optimize){_optimizeOrder = optimize;}
+
+			/**
+			 * Enable compact storage for following uploads of 3D meshes with set3D(), set3DIndexed() and setOBJ():
+			 * positions are stored as normalized 16 bit integers relative to the bounding box of the mesh (8 bytes instead of 12),
+			 * normals are octahedral encoded in two normalized 16 bit integers (4 bytes instead of 12).
+			 * NOTE: the shader has to decode the components (see Shader::setVertexDecodeLocations()), bind() sets the decode uniforms.
+			 */
+			void setQuantization(bool quantize){_quantize = quantize;}
+			bool isQuantized()const{return _quantized;}
+
 			/**
 			 * set from 3D vertex data
 			 * the data is thightly packed position/normal/uv data depending on what components are specified
@@ -91,10 +179,31 @@ namespace zer0{
 
 			/**
 			 * set from indexed 3D vertex data (uses element buffer)
+			 * indices are stored with 16 bit if num_verts does not exceed 65536
 			 * @param vertex_data is the same as param data in set3D()
 			 */
 			void set3DIndexed(const float * vertex_data, size_t num_verts, const unsigned int * index_data, size_t num_indices, unsigned char components, GLenum draw_mode);
 
+			/**
+			 * set indices into the vertex buffer of another mesh, so vertices drawn by multiple meshes (e.g. faces and edges) are uploaded only once
+			 * The buffer is not copied, components and quantization are taken from source.
+			 * NOTE: source must not be cleared or set again while this mesh is in use, call setShared() again after source was set.
+			 *       source must not reorder its vertices (see setOptimizeOrder()).
+			 * @param source mesh that owns the vertex buffer (3D)
+			 * @param index_data indices into the vertices of source
+			 */
+			void setShared(const Mesh & source, const unsigned int * index_data, size_t num_indices, GLenum draw_mode);
+
+			/**
+			 * overwrite a range of vertices of a mesh that was set with set3D()/set3DIndexed(), the buffer is not reallocated
+			 * @param data thightly packed position/normal/uv data (same format as in set3D()) for num_verts vertices
+			 * @param first_vertex index of first vertex to overwrite
+			 * @param num_verts number of vertices to overwrite, first_vertex+num_verts must not exceed getVertexCount()
+			 * @return false if the mesh is quantized and a position lies outside the bounding box it was quantized with (position is clamped),
+			 *         the mesh has to be set again to show the data correctly
+			 */
+			bool update3D(const float * data, size_t first_vertex, size_t num_verts);
+
 			/**
 			 * Free gl buffers
 			 */
@@ -103,6 +212,10 @@ namespace zer0{
 			/**
 			 * Binding buffer to vertex attribute locations and setting pointers.
 			 * Must be called before drawing the mesh.
+			 * If CONFIG.SUPPORTS_NEW_GL is set, the attribute setup is recorded in a vertex array object on the first bind
+			 * with the current shader's attribute locations, every following bind is a single glBindVertexArray().
+			 * NOTE: vertex arrays enabled after bind() (e.g. Shader::setInstancePointer()) are recorded in that vertex array object,
+			 *       disable them after drawing (e.g. Shader::disableInstanceArray()).
 			 * @param flags specify what components to bind (if available)
 			 */
 			void bind(GLubyte flags = 0xFF);
@@ -112,6 +225,22 @@ namespace zer0{
 			 */
 			void draw();
 
+			/**
+			 * Drawing mesh num_instances times with a single draw call, per-instance attributes are set with Shader::setInstancePointer().
+			 * Call bind() before.
+			 * NOTE: requires OpenGL 3.3 (CONFIG.SUPPORTS_NEW_GL)
+			 */
+			void drawInstanced(GLsizei num_instances);
+
+			/**
+			 * Drawing multiple ranges of the element buffer (indexed meshes) or of the vertices (non-indexed meshes) with a single draw call.
+			 * Call bind() before.
+			 * @param first_elements index of first element/vertex of every range
+			 * @param counts number of elements/vertices of every range
+			 * @param num_ranges number of ranges
+			 */
+			void drawRanges(const GLsizei * first_elements, const GLsizei * counts, GLsizei num_ranges);
+
 			/**
 			 * Generate vertex data for circle parallel to the XY-plane.
 			 * @param v Array to write vertex data to. There must be space allocated for at least sizeof(Vector3D)*segments
@@ -123,19 +252,84 @@ namespace zer0{
 
 
 
+			/**
+			 * Statistics of all draw calls and uploads of meshes since the last reset (see RenderStatistics).
+			 */
+			static RenderStatistics & getStatistics(){return _statistics;}
+
+			/**
+			 * Count bytes written to a buffer object without a mesh (e.g. instance data), so they show up in getStatistics().
+			 * @param allocated the storage was (re)allocated by the upload (glBufferData())
+			 */
+			static void countUpload(size_t bytes, bool allocated = false){
+				_statistics.uploadedBytes += bytes;
+				_statistics.bufferAllocations += allocated;
+			}
+
 			GLuint getBuffer(){return _buffer;}
 
 			GLsizei getVertexCount(){return _vertexCount;}
 			GLsizei getElementCount(){return _elementCount;}
 		protected:
+			/* set attribute pointers of current shader to buffer and bind element buffer */
+			void setAttributePointers(GLubyte flags);
+
+			/* count vertices (non-indexed) or indices drawn with the draw mode of this mesh and the resulting triangles */
+			void countPrimitives(size_t count, size_t num_instances = 1)const;
+
+			/* upload data to given buffer (created if 0), storage is reused if data fits into capacity */
+			void uploadBuffer(GLenum target, GLuint & buffer, GLsizeiptr & capacity, const void * data, GLsizeiptr size);
+
+			/* set element buffer from indices, narrowest index type that can address num_verts vertices is chosen */
+			void setElements(const GLuint * indices, size_t num_indices, size_t num_verts);
+
+			/* upload vertices and indices of parsed wavefront object as they are */
+			void uploadOBJ(const OBJData & data);
+
+			/* set vertex data of given dimension, buffers are kept if possible (see setUsage()) */
+			void setVertexData(const float * data, size_t num_verts, int num_dimensions, unsigned char components, GLenum draw_mode);
+
+			/* write quantized positions (4 GLushort per vertex) and octahedral normals (2 GLshort per vertex) of planar vertex data,
+			 * returns false if a position was clamped to the bounding box */
+			bool quantizeVertices(const float * data, size_t num_verts, void * positions, void * normals)const;
+
+			/* size of a single position/normal in the buffer in bytes */
+			size_t getPositionSize()const{return _quantized ? 4*sizeof(GLushort) : _numDimensions*sizeof(float);}
+			size_t getNormalSize()const{return _quantized ? 2*sizeof(GLshort) : 3*sizeof(float);}
+
+			/* delete element buffer (mesh is not indexed anymore) */
+			void deleteElementBuffer();
+
+			/* delete recorded vertex array objects, needs to be called whenever the buffer layout changes */
+			void clearVertexArrays();
+
+			/* vertex array object recording the attribute setup for a specific set of attribute locations */
+			struct VertexArray{
+				GLint locations[4];// vertex, normal, uv and color location of the shader the vao was recorded with
+				GLubyte flags;// components that are bound
+				GLuint vao;
+			};
+			std::vector<VertexArray> _vertexArrays;
+
 			GLuint _buffer;	
 			GLuint _elementBuffer;
+			GLsizeiptr _bufferCapacity;// size of storage allocated for _buffer in bytes
+			GLsizeiptr _elementBufferCapacity;// size of storage allocated for _elementBuffer in bytes
+			GLenum _usage;// usage hint for buffer storage
+			bool _sharedBuffer;// _buffer belongs to another mesh (see setShared())
+			bool _optimizeOrder;// reorder triangles/vertices on upload
+			bool _quantize;// quantize components on upload
+			bool _quantized;// components in buffer are quantized
+			Vector3D _positionOffset;// quantized positions are decoded as offset + scale*position
+			Vector3D _positionScale;
 			int _numDimensions;//2D/3D object
 			GLsizei _vertexCount;// number of vertices in buffer
 			GLsizei _elementCount;// actual number of indices in element buffer
 			GLenum _drawMode;
 			GLenum _elementType;
 			GLubyte _flags;// flags store whether normals/uvs/colors are stored along with vertex position
+
+			static RenderStatistics _statistics;
 	};
 };
 
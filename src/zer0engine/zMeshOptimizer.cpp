@@ -0,0 +1,212 @@
+/* Author: Cornelius Marx
+ */
+#include "zMeshOptimizer.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace zer0;
+
+/* marks vertices that have not been chosen */
+static const unsigned int INVALID_VERTEX = ~0u;
+
+/* group of successive triangles between two cache flushes */
+struct TriangleCluster{
+	size_t first;// index of first triangle
+	size_t count;// number of triangles
+	float sortKey;
+};
+
+/* sort clusters from outside facing to inside facing relative to the center of the mesh (Nehab et al. 2006) */
+static void sortClusters(unsigned int * indices, size_t num_indices, const Vector3D * positions, std::vector<TriangleCluster> & clusters)
+{
+	const size_t num_tris = num_indices/3;
+	Vector3D mesh_center(0, 0, 0);
+	for(size_t i = 0; i < num_indices; i++){
+		mesh_center += positions[indices[i]];
+	}
+	mesh_center /= num_indices;
+
+	for(TriangleCluster & c : clusters){
+		Vector3D center(0, 0, 0);
+		Vector3D normal(0, 0, 0);
+		for(size_t t = c.first; t < c.first + c.count; t++){
+			const Vector3D & p0 = positions[indices[3*t+0]];
+			const Vector3D & p1 = positions[indices[3*t+1]];
+			const Vector3D & p2 = positions[indices[3*t+2]];
+			center += p0 + p1 + p2;
+			// area weighted
+			normal += Vector3D::cross(p1-p0, p2-p0);
+		}
+		center /= 3*c.count;
+		float normal_length = normal.getLength();
+		c.sortKey = normal_length > 0 ? Vector3D::dot(center-mesh_center, normal)/normal_length : 0;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const TriangleCluster & a, const TriangleCluster & b){return a.sortKey > b.sortKey;});
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(num_indices);
+	for(const TriangleCluster & c : clusters){
+		sorted.insert(sorted.end(), indices + 3*c.first, indices + 3*(c.first + c.count));
+	}
+	assert(sorted.size() == 3*num_tris);
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void zer0::optimizeTriangleOrder(unsigned int * indices, size_t num_indices, const Vector3D * positions, size_t num_verts, int cache_size)
+{
+	const size_t num_tris = num_indices/3;
+	if(num_tris == 0){
+		return;
+	}
+
+	// number of triangles not emitted yet for every vertex
+	std::vector<unsigned int> live(num_verts, 0);
+	for(size_t i = 0; i < 3*num_tris; i++){
+		live[indices[i]]++;
+	}
+
+	// triangles adjacent to every vertex (adjacency[adjacency_offset[v]] to adjacency[adjacency_offset[v+1]-1])
+	std::vector<size_t> adjacency_offset(num_verts+1, 0);
+	for(size_t v = 0; v < num_verts; v++){
+		adjacency_offset[v+1] = adjacency_offset[v] + live[v];
+	}
+	std::vector<unsigned int> adjacency(3*num_tris);
+	{
+		std::vector<size_t> fill(adjacency_offset.begin(), adjacency_offset.end()-1);
+		for(size_t i = 0; i < 3*num_tris; i++){
+			adjacency[fill[indices[i]]++] = i/3;
+		}
+	}
+
+	// a vertex is in the cache if less than cache_size misses happened since it was inserted
+	std::vector<int> cache_time(num_verts, 0);
+	int time = cache_size+1;
+	std::vector<char> emitted(num_tris, 0);
+	std::vector<unsigned int> dead_end;// stack of recently referenced vertices
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(3*num_tris);
+	std::vector<TriangleCluster> clusters;
+	size_t cursor = 0;// next vertex (in input order) to check if the dead-end stack is empty
+
+	// fan around current vertex, emitting all its remaining triangles, then continue with a neighbour that is likely still in the cache
+	while(cursor < num_verts && live[cursor] == 0){
+		cursor++;
+	}
+	unsigned int fan_vertex = cursor < num_verts ? cursor : INVALID_VERTEX;
+	clusters.push_back(TriangleCluster{0, 0, 0});
+	while(fan_vertex != INVALID_VERTEX){
+		candidates.clear();
+		for(size_t a = adjacency_offset[fan_vertex]; a < adjacency_offset[fan_vertex+1]; a++){
+			unsigned int t = adjacency[a];
+			if(emitted[t]){
+				continue;
+			}
+			for(int j = 0; j < 3; j++){
+				unsigned int v = indices[3*t+j];
+				output.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if(time - cache_time[v] > cache_size){
+					cache_time[v] = time;
+					time++;
+				}
+			}
+			emitted[t] = 1;
+		}
+
+		// prefer oldest candidate that will still be in the cache after fanning around it
+		unsigned int next = INVALID_VERTEX;
+		int best_priority = -1;
+		for(unsigned int v : candidates){
+			if(live[v] == 0){
+				continue;
+			}
+			int priority = 0;
+			if(time - cache_time[v] + 2*(int)live[v] <= cache_size){
+				priority = time - cache_time[v];
+			}
+			if(priority > best_priority){
+				best_priority = priority;
+				next = v;
+			}
+		}
+
+		// dead end: most recently referenced vertex with remaining triangles, next vertex in input order otherwise
+		if(next == INVALID_VERTEX){
+			while(!dead_end.empty() && next == INVALID_VERTEX){
+				unsigned int v = dead_end.back();
+				dead_end.pop_back();
+				if(live[v] > 0){
+					next = v;
+				}
+			}
+			if(next == INVALID_VERTEX){
+				while(cursor < num_verts && live[cursor] == 0){
+					cursor++;
+				}
+				if(cursor < num_verts){
+					next = cursor;
+				}
+			}
+			// a new cluster starts if the cache has to be refilled
+			if(next != INVALID_VERTEX && time - cache_time[next] > cache_size){
+				clusters.back().count = output.size()/3 - clusters.back().first;
+				clusters.push_back(TriangleCluster{output.size()/3, 0, 0});
+			}
+		}
+		fan_vertex = next;
+	}
+	clusters.back().count = output.size()/3 - clusters.back().first;
+	assert(output.size() == 3*num_tris);
+	std::copy(output.begin(), output.end(), indices);
+
+	if(positions != nullptr){
+		sortClusters(indices, 3*num_tris, positions, clusters);
+	}
+}
+
+void zer0::optimizeVertexOrder(unsigned int * indices, size_t num_indices, size_t num_verts, std::vector<unsigned int> & remap)
+{
+	remap.assign(num_verts, INVALID_VERTEX);
+	unsigned int next = 0;
+	for(size_t i = 0; i < num_indices; i++){
+		unsigned int & v = indices[i];
+		if(remap[v] == INVALID_VERTEX){
+			remap[v] = next++;
+		}
+		v = remap[v];
+	}
+	for(size_t v = 0; v < num_verts; v++){
+		if(remap[v] == INVALID_VERTEX){
+			remap[v] = next++;
+		}
+	}
+}
+
+void zer0::remapVertices(const float * src, float * dst, size_t num_verts, int num_floats, const std::vector<unsigned int> & remap)
+{
+	for(size_t v = 0; v < num_verts; v++){
+		std::copy(src + v*num_floats, src + (v+1)*num_floats, dst + remap[v]*num_floats);
+	}
+}
+
+float zer0::getACMR(const unsigned int * indices, size_t num_indices, size_t num_verts, int cache_size)
+{
+	if(num_indices < 3){
+		return 0;
+	}
+	// number of misses at the time every vertex was inserted into the cache, 0 if never
+	std::vector<size_t> insert_time(num_verts, 0);
+	size_t misses = 0;
+	for(size_t i = 0; i < num_indices; i++){
+		unsigned int v = indices[i];
+		if(insert_time[v] == 0 || misses - insert_time[v] >= (size_t)cache_size){
+			misses++;
+			insert_time[v] = misses;
+		}
+	}
+	return misses/(float)(num_indices/3);
+}
@@ -0,0 +1,49 @@
+/* Author: Cornelius Marx
+ */
+#ifndef ZER0_MESH_OPTIMIZER_H
+#define ZER0_MESH_OPTIMIZER_H
+
+#include "zVector3D.h"
+#include <vector>
+#include <cstddef>
+
+/* number of entries of the post-transform vertex cache that is optimized for */
+#define ZER0_VERTEX_CACHE_SIZE 16
+
+namespace zer0{
+
+	/**
+	 * Reorder triangles of an indexed triangle list, so successive triangles share vertices that are still in the post-transform vertex cache
+	 * (Tipsify, Sander et al. 2007: Fast Triangle Reordering for Vertex Locality and Reduced Overdraw), runs in linear time.
+	 * If positions are given, the clusters of triangles separated by cache flushes are additionally sorted so outward facing parts
+	 * of the mesh are drawn first, which reduces overdraw from most view directions.
+	 * @param indices 3 successive indices form a triangle, reordered in place
+	 * @param num_indices number of indices (multiple of 3)
+	 * @param positions vertex positions used for overdraw sorting, nullptr to only optimize for the vertex cache
+	 * @param num_verts number of vertices, every index must be smaller
+	 * @param cache_size number of entries of the vertex cache
+	 */
+	void optimizeTriangleOrder(unsigned int * indices, size_t num_indices, const Vector3D * positions, size_t num_verts,
+								int cache_size = ZER0_VERTEX_CACHE_SIZE);
+
+	/**
+	 * Reorder vertices in the order they are first referenced by indices, so vertex fetches access memory sequentially.
+	 * Vertices that are not referenced are moved behind all referenced ones (keeping their order).
+	 * @param indices index list, rewritten to refer to the new vertex positions
+	 * @param remap set to the new position of every vertex (size num_verts), see remapVertices()
+	 */
+	void optimizeVertexOrder(unsigned int * indices, size_t num_indices, size_t num_verts, std::vector<unsigned int> & remap);
+
+	/**
+	 * Move num_verts elements of given size (in floats) to the positions given by remap (see optimizeVertexOrder()).
+	 */
+	void remapVertices(const float * src, float * dst, size_t num_verts, int num_floats, const std::vector<unsigned int> & remap);
+
+	/**
+	 * Average cache miss ratio: number of vertex shader invocations per triangle when drawing given indices with a FIFO cache of given size.
+	 * Ranges from 0.5 (ideal for large regular meshes) to 3.
+	 */
+	float getACMR(const unsigned int * indices, size_t num_indices, size_t num_verts, int cache_size = ZER0_VERTEX_CACHE_SIZE);
+};
+
+#endif
@@ -0,0 +1,45 @@
+/* Author: Cornelius Marx
+ */
+#ifndef ZER0_PARALLEL_H
+#define ZER0_PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace zer0{
+
+	/**
+	 * Split [0, count) into contiguous chunks and call func(begin, end) for every chunk on its own thread,
+	 * returns when all chunks have been processed. The calling thread processes the first chunk itself.
+	 * @param count number of elements
+	 * @param min_chunk_size minimum number of elements per thread, so small ranges do not pay for creating threads
+	 * @param func callable taking (size_t begin, size_t end), must be safe to call concurrently for disjoint ranges
+	 * NOTE: func must not call any OpenGL functions
+	 */
+	template<typename F>
+	void parallelFor(size_t count, size_t min_chunk_size, F func)
+	{
+		size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+		num_threads = std::min(num_threads, count/std::max<size_t>(min_chunk_size, 1));
+		if(num_threads <= 1){
+			if(count > 0){
+				func(size_t(0), count);
+			}
+			return;
+		}
+		size_t chunk_size = (count + num_threads - 1)/num_threads;
+		std::vector<std::thread> workers;
+		workers.reserve(num_threads-1);
+		for(size_t begin = chunk_size; begin < count; begin += chunk_size){
+			workers.push_back(std::thread(func, begin, std::min(count, begin + chunk_size)));
+		}
+		func(size_t(0), chunk_size);
+		for(std::thread & w : workers){
+			w.join();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,133 @@
+/* Author: Cornelius Marx
+ */
+#include "zPixelReader.h"
+#include "zConfig.h"
+#include "zLogger.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace zer0;
+
+PixelReader::PixelReader(): _first(0), _numPending(0)
+{
+}
+
+PixelReader::~PixelReader()
+{
+	clear();
+}
+
+bool PixelReader::request(int x, int y, int w, int h)
+{
+	if(_numPending == ZER0_PIXEL_READER_BUFFERS){
+		return false;
+	}
+	Request & r = _requests[(_first + _numPending)%ZER0_PIXEL_READER_BUFFERS];
+	if(r.buffer == 0){
+		glGenBuffers(1, &r.buffer);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, r.buffer);
+	// storage is only reallocated if the size changed
+	if(r.w*r.h != w*h){
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)w*h*4, NULL, GL_STREAM_READ);
+	}
+	r.w = w;
+	r.h = h;
+	// with a pack buffer bound the last parameter is an offset into the buffer, the call returns without waiting for the copy
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if(CONFIG.SUPPORTS_NEW_GL){
+		r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		// make sure the commands are submitted, so polling isReady() eventually succeeds
+		glFlush();
+	}
+	_numPending++;
+	return true;
+}
+
+bool PixelReader::isReady()
+{
+	if(_numPending == 0){
+		return false;
+	}
+	Request & r = _requests[_first];
+	if(r.fence == 0){
+		return true;
+	}
+	GLenum res = glClientWaitSync(r.fence, 0, 0);
+	return res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED;
+}
+
+bool PixelReader::fetch(std::vector<unsigned char> & pixels, int & w, int & h)
+{
+	if(_numPending == 0){
+		return false;
+	}
+	Request & r = _requests[_first];
+	_first = (_first+1)%ZER0_PIXEL_READER_BUFFERS;
+	_numPending--;
+	if(r.fence != 0){
+		glDeleteSync(r.fence);
+		r.fence = 0;
+	}
+	w = r.w;
+	h = r.h;
+	size_t row_size = (size_t)w*4;
+	pixels.resize(row_size*h);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, r.buffer);
+	const unsigned char * data = (const unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if(data == NULL){
+		ERROR("Unable to map pixel buffer.");
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		return false;
+	}
+	// gl returns the bottom row first
+	for(int y = 0; y < h; y++){
+		memcpy(&pixels[y*row_size], data + (h-1-y)*row_size, row_size);
+	}
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
+
+void PixelReader::clear()
+{
+	for(Request & r : _requests){
+		if(r.fence != 0){
+			glDeleteSync(r.fence);
+		}
+		if(r.buffer != 0){
+			glDeleteBuffers(1, &r.buffer);
+		}
+		r = Request();
+	}
+	_first = 0;
+	_numPending = 0;
+}
+
+bool PixelReader::writePPM(const char * filename, const unsigned char * pixels, int w, int h)
+{
+	FILE * f = fopen(filename, "wb");
+	if(f == NULL){
+		ERROR("Unable to open file '%s' for writing.", filename);
+		return false;
+	}
+	fprintf(f, "P6\n%d %d\n255\n", w, h);
+	std::vector<unsigned char> row(w*3);
+	bool ok = true;
+	for(int y = 0; y < h && ok; y++){
+		const unsigned char * src = pixels + (size_t)y*w*4;
+		for(int x = 0; x < w; x++){
+			row[3*x+0] = src[4*x+0];
+			row[3*x+1] = src[4*x+1];
+			row[3*x+2] = src[4*x+2];
+		}
+		ok = fwrite(row.data(), 1, row.size(), f) == row.size();
+	}
+	fclose(f);
+	if(!ok){
+		ERROR("Failed to write image '%s'.", filename);
+	}
+	return ok;
+}
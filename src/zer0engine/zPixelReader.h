@@ -0,0 +1,73 @@
+/* Author: Cornelius Marx
+ */
+#ifndef ZER0_PIXEL_READER_H
+#define ZER0_PIXEL_READER_H
+
+#include "glew/glew.h"
+#include <vector>
+
+/* number of pixel buffers, i.e. number of reads that can be pending at once */
+#define ZER0_PIXEL_READER_BUFFERS 2
+
+namespace zer0{
+
+	/**
+	 * Asynchronous readback of framebuffer contents through pixel buffer objects.
+	 * request() only queues the copy into a pixel buffer and returns immediately, the pixels are mapped by fetch() later on,
+	 * so the cpu can do other work (e.g. prepare the next frame) while the gpu is still rendering and copying.
+	 * With OpenGL 3.3 every request is followed by a fence, so isReady() can tell whether fetch() would block.
+	 * NOTE: all functions have to be called from the thread that owns the gl context
+	 */
+	class PixelReader
+	{
+	public:
+		PixelReader();
+		~PixelReader();
+
+		/**
+		 * Start reading given region of the framebuffer currently bound for reading.
+		 * @return false if ZER0_PIXEL_READER_BUFFERS reads are already pending (fetch() one first), true on success
+		 */
+		bool request(int x, int y, int w, int h);
+
+		/**
+		 * Get pixels of the oldest pending read, waits for the gpu to finish it if necessary.
+		 * @param pixels set to w*h RGBA pixels, rows from top to bottom
+		 * @param w set to width of the region read
+		 * @param h set to height of the region read
+		 * @return false if no read is pending, true on success
+		 */
+		bool fetch(std::vector<unsigned char> & pixels, int & w, int & h);
+
+		/**
+		 * @return true if the oldest pending read has finished, so fetch() does not block
+		 *  (always true without fences, i.e. OpenGL < 3.3)
+		 */
+		bool isReady();
+
+		/* number of reads requested but not fetched yet */
+		int getNumPending()const{return _numPending;}
+
+		/* delete pixel buffers and fences, pending reads are discarded */
+		void clear();
+
+		/**
+		 * Write RGBA pixels (rows from top to bottom, as returned by fetch()) to a binary portable pixmap (.ppm), alpha is dropped.
+		 * @return false if the file could not be written, true on success
+		 */
+		static bool writePPM(const char * filename, const unsigned char * pixels, int w, int h);
+
+	private:
+		struct Request{
+			Request(): buffer(0), fence(0), w(0), h(0){}
+			GLuint buffer;
+			GLsync fence;
+			int w, h;
+		};
+		Request _requests[ZER0_PIXEL_READER_BUFFERS];
+		int _first;// oldest pending request
+		int _numPending;
+	};
+};
+
+#endif
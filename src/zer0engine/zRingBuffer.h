@@ -0,0 +1,109 @@
+/* Author: Cornelius Marx
+ */
+#ifndef ZER0_RING_BUFFER_H
+#define ZER0_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace zer0{
+
+	/**
+	 * Bounded lock-free queue with a fixed number of slots (multiple producers, multiple consumers).
+	 * Every slot carries a sequence number that tells producers/consumers whether the slot is ready for them,
+	 * so no locks are needed and a full queue is detected without blocking.
+	 * @param T Type of the elements, must be copy-assignable
+	 * @param N Number of slots, must be a power of two
+	 */
+	template <typename T, size_t N>
+	class RingBuffer
+	{
+	public:
+		RingBuffer(): _head(0), _tail(0){
+			static_assert(N >= 2 && (N & (N-1)) == 0, "RingBuffer size must be a power of two");
+			for(size_t i = 0; i < N; i++){
+				_slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		/**
+		 * Append an element at the end of the queue.
+		 * @return false if the queue is full, true on success
+		 */
+		bool push(const T & item){
+			Slot * slot;
+			size_t pos = _tail.load(std::memory_order_relaxed);
+			while(1){
+				slot = &_slots[pos & (N-1)];
+				size_t seq = slot->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+				if(diff == 0){// slot is free, try to claim it
+					if(_tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)){
+						break;
+					}
+				}
+				else if(diff < 0){// slot still occupied -> queue full
+					return false;
+				}
+				else{// another producer was faster
+					pos = _tail.load(std::memory_order_relaxed);
+				}
+			}
+			slot->data = item;
+			slot->sequence.store(pos+1, std::memory_order_release);
+			return true;
+		}
+
+		/**
+		 * Remove the first element of the queue.
+		 * @param item the removed element is written to item
+		 * @return false if the queue is empty, true on success
+		 */
+		bool pop(T & item){
+			Slot * slot;
+			size_t pos = _head.load(std::memory_order_relaxed);
+			while(1){
+				slot = &_slots[pos & (N-1)];
+				size_t seq = slot->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)(pos+1);
+				if(diff == 0){// slot is filled, try to claim it
+					if(_head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)){
+						break;
+					}
+				}
+				else if(diff < 0){// slot not yet filled -> queue empty
+					return false;
+				}
+				else{// another consumer was faster
+					pos = _head.load(std::memory_order_relaxed);
+				}
+			}
+			item = slot->data;
+			slot->sequence.store(pos+N, std::memory_order_release);
+			return true;
+		}
+
+		/**
+		 * returns true if there is currently no element in the queue
+		 * NOTE: the result may be outdated immediately if other threads are pushing/popping concurrently
+		 */
+		bool empty()const{
+			return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+		}
+
+	private:
+		struct Slot{
+			std::atomic<size_t> sequence;
+			T data;
+		};
+		Slot _slots[N];
+		// head and tail are kept on separate cache lines, so producers and consumers do not compete for the same line
+		char _pad0[64];
+		std::atomic<size_t> _head;// position of next element to pop
+		char _pad1[64];
+		std::atomic<size_t> _tail;// position of next element to push
+	};
+};
+
+#endif
@@ -1,10 +1,47 @@
 #include "zShader.h"
+#include "zMesh.h"
+#include <cstring>
 
 using namespace zer0;
 
 Shader* Shader::_current = NULL;
 Shader Shader::DefaultShader("Default-Shader");
 Shader Shader::TextShader("Text-Shader");
+GLuint Shader::_cameraBuffer = 0;
+Matrix4 Shader::_cameraMatrices[2];
+bool Shader::_cameraMatricesValid[2] = {false, false};
+GLint Shader::_currentColorLocation = -1;
+Color Shader::_currentColor;
+
+/* compile shader stage from source, ZER0_UNIFORM_BLOCKS is defined after the #version line if uniform blocks are supported */
+static void compileShader(GLuint shader, const char * source)
+{
+	std::string version;
+	const char * body = source;
+	if(strncmp(source, "#version", 8) == 0){
+		const char * line_end = strchr(source, '\n');
+		if(line_end != NULL){
+			version.assign(source, line_end+1);
+			body = line_end+1;
+		}
+	}
+	const char * sources[3] = {version.c_str(), CONFIG.SUPPORTS_NEW_GL ? "#define ZER0_UNIFORM_BLOCKS\n" : "", body};
+	glShaderSource(shader, 3, sources, 0);
+	glCompileShader(shader);
+}
+
+void Shader::setCameraBlockMatrix(int index, const Matrix4 & m)
+{
+	if(_cameraMatricesValid[index] && memcmp(&_cameraMatrices[index], &m, sizeof(Matrix4)) == 0){
+		return;
+	}
+	_cameraMatrices[index] = m;
+	_cameraMatricesValid[index] = true;
+	glBindBuffer(GL_UNIFORM_BUFFER, _cameraBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, index*sizeof(Matrix4), sizeof(Matrix4), &m);
+	Mesh::countUpload(sizeof(Matrix4));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
 
 GLint Shader::getLocation(const char * name, bool is_uniform)
 {
@@ -31,11 +68,10 @@ bool Shader::initDefaultShaders()
 	// default shader
 	static const char* VERTEX_SHADER_SOURCE =
 		"#version 120\n"
+		ZER0_SHADER_CAMERA_UNIFORMS
 		"attribute vec3 vertex;\n"
 		"attribute vec4 color;\n"
 		"varying vec4 out_color;\n"
-		"uniform mat4 projMat;\n"
-		"uniform mat4 viewMat;\n"
 		"uniform mat4 modelMat;\n"
 		"void main()\n"
 		"{\n"
@@ -79,8 +115,7 @@ bool Shader::load(	const char * vertex_shader_source,
 	int error = 0;
 	//create and compile vertex shader
 	GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex_shader, 1, &vertex_shader_source, 0);
-	glCompileShader(vertex_shader);
+	compileShader(vertex_shader, vertex_shader_source);
 	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
 	if(success == GL_FALSE){
 		ERROR("Shader '%s': Error during vertex compilation", _name.c_str());
@@ -89,8 +124,7 @@ bool Shader::load(	const char * vertex_shader_source,
 
 	//create and compile fragment shader
 	GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment_shader, 1, &fragment_shader_source, 0);
-	glCompileShader(fragment_shader);
+	compileShader(fragment_shader, fragment_shader_source);
 	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
 	if(success == GL_FALSE){
 		ERROR("Shader '%s': Error during fragment compilation", _name.c_str());
@@ -101,7 +135,7 @@ bool Shader::load(	const char * vertex_shader_source,
 	glAttachShader(_program, vertex_shader);
 	glAttachShader(_program, fragment_shader);
 	glLinkProgram(_program);
-	glGetShaderiv(_program, GL_LINK_STATUS, &success);
+	glGetProgramiv(_program, GL_LINK_STATUS, &success);
 	if(success == GL_FALSE){
 		ERROR("Shader '%s': Error during program linking", _name.c_str());
 		error++;	
@@ -143,6 +177,23 @@ bool Shader::load(	const char * vertex_shader_source,
 		return false;
 	}
 
+	// projection and view matrix are shared by all shaders using the camera block
+	_cameraBlock = false;
+	if(CONFIG.SUPPORTS_NEW_GL){
+		GLuint block_index = glGetUniformBlockIndex(_program, "Camera");
+		if(block_index != GL_INVALID_INDEX){
+			glUniformBlockBinding(_program, block_index, ZER0_CAMERA_BLOCK_BINDING);
+			_cameraBlock = true;
+			if(_cameraBuffer == 0){
+				glGenBuffers(1, &_cameraBuffer);
+				glBindBuffer(GL_UNIFORM_BUFFER, _cameraBuffer);
+				glBufferData(GL_UNIFORM_BUFFER, 2*sizeof(Matrix4), NULL, GL_DYNAMIC_DRAW);
+				glBindBuffer(GL_UNIFORM_BUFFER, 0);
+				glBindBufferBase(GL_UNIFORM_BUFFER, ZER0_CAMERA_BLOCK_BINDING, _cameraBuffer);
+			}
+		}
+	}
+
 	return true;
 
 }
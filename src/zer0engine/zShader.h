@@ -8,12 +8,28 @@
 #include "zVector3D.h"
 #include "zVector2D.h"
 #include "zMatrix4.h"
+#include "zUniform.h"
 #include <string>
 #include "zConfig.h"
 #include <errno.h>
 
 /* macro for getting current shader */
 #define SHADER Shader::getCurrent()
+
+/* uniform buffer binding point of the camera block shared by all shaders */
+#define ZER0_CAMERA_BLOCK_BINDING 0
+
+/* declaration of projection (projMat) and view matrix (viewMat) for shader sources, must directly follow the #version line.
+ * With OpenGL 3.3 (CONFIG.SUPPORTS_NEW_GL) the matrices are read from a uniform block that is shared by all shaders,
+ * so they are uploaded once per change instead of once per shader (see Shader::setProjectionMatrix()). */
+#define ZER0_SHADER_CAMERA_UNIFORMS \
+	"#ifdef ZER0_UNIFORM_BLOCKS\n" \
+	"#extension GL_ARB_uniform_buffer_object : enable\n" \
+	"layout(std140) uniform Camera{mat4 projMat; mat4 viewMat;};\n" \
+	"#else\n" \
+	"uniform mat4 projMat;\n" \
+	"uniform mat4 viewMat;\n" \
+	"#endif\n"
 namespace zer0{
 
 	/* forward declaration for friendship */
@@ -29,7 +45,7 @@ namespace zer0{
 		 * Constructor
 		 */
 		Shader(const char * name = "default"): _name(name), _program(0), _vertexLocation(-1), _uvLocation(-1), _normalLocation(-1), _colorLocation(-1),
-				_samplerLocation(-1), _viewMatrixLocation(-1), _projectionMatrixLocation(-1), _modelMatrixLocation(-1){}
+				_instanceLocation(-1), _samplerLocation(-1), _cameraBlock(false){}
 
 		/**
 		 * Destructor
@@ -42,6 +58,7 @@ namespace zer0{
 
 		/**
 		 * compile shader program from source of different shader stages
+		 * If CONFIG.SUPPORTS_NEW_GL is set, ZER0_UNIFORM_BLOCKS is defined in both stages (see ZER0_SHADER_CAMERA_UNIFORMS).
 		 * @param vertex Source code for vertex shader stage
 		 * @param fragment Source code for fragment shader stage
 		 * @return True on success, false on failure
@@ -70,14 +87,20 @@ namespace zer0{
 		{_colorLocation = getLocation(name, false);}
 		void setNormalLocation(const char * name)
 		{_normalLocation = getLocation(name, false);}
+		void setInstanceLocation(const char * name)
+		{_instanceLocation = getLocation(name, false);}
+		/* projection and view matrix are part of the camera block if the shader uses it */
 		void setProjectionMatrixLocation(const char * name)
-		{_projectionMatrixLocation = getLocation(name, true);}
+		{if(!_cameraBlock)_projectionMatrix.setLocation(getLocation(name, true));}
 		void setModelMatrixLocation(const char * name)
-		{_modelMatrixLocation = getLocation(name, true);}
+		{_modelMatrix.setLocation(getLocation(name, true));}
 		void setViewMatrixLocation(const char * name)
-		{_viewMatrixLocation = getLocation(name, true);}
+		{if(!_cameraBlock)_viewMatrix.setLocation(getLocation(name, true));}
 		void setSamplerLocation(const char * name)
 		{_samplerLocation = getLocation(name, true);}
+		/* uniforms for decoding quantized vertices (see setVertexDecode()) */
+		void setVertexDecodeLocations(const char * offset_name, const char * scale_name, const char * oct_normals_name)
+		{_vertexOffset.setLocation(getLocation(offset_name, true)); _vertexScale.setLocation(getLocation(scale_name, true)); _octNormals.setLocation(getLocation(oct_normals_name, true));}
 
 		/**
 		 * Get location of vertex attribute or uniform
@@ -88,12 +111,17 @@ namespace zer0{
 		GLint getLocation(const char * name, bool is_uniform);
 
 		/**
-		 * Set matrix in shader.
+		 * Set matrix in shader, nothing is uploaded if the matrix did not change.
+		 * If the shader uses the camera block (see ZER0_SHADER_CAMERA_UNIFORMS), projection and view matrix are set for all shaders using it.
 		 * @param m The matrix to upload to shader program
 		 */
-		void setProjectionMatrix(const Matrix4 & m){glUniformMatrix4fv(_projectionMatrixLocation, 1, GL_FALSE, (GLfloat*)&m);}
-		void setViewMatrix(const Matrix4 & m){glUniformMatrix4fv(_viewMatrixLocation, 1, GL_FALSE, (GLfloat*)&m);}
-		void setModelMatrix(const Matrix4 & m){glUniformMatrix4fv(_modelMatrixLocation, 1, GL_FALSE, (GLfloat*)&m);}
+		void setProjectionMatrix(const Matrix4 & m){
+			if(_cameraBlock)setCameraBlockMatrix(0, m);
+			else _projectionMatrix.set(m);}
+		void setViewMatrix(const Matrix4 & m){
+			if(_cameraBlock)setCameraBlockMatrix(1, m);
+			else _viewMatrix.set(m);}
+		void setModelMatrix(const Matrix4 & m){_modelMatrix.set(m);}
 
 		/*
 		void setProjectionMatrix(const Matrix3 & m){glUniformMatrix3fv(_projectionMatrixLocation, 1, GL_FALSE, (GLfloat*)&m);}
@@ -102,10 +130,27 @@ namespace zer0{
 		*/
 
 		/**
-		 * Set color vertex attribute in shader.
+		 * Set color vertex attribute in shader, nothing is done if the color did not change since the last call.
 		 * @param c The color to set the color vertex attribute to.
 		 */
-		void setColor(const Color & c){glDisableVertexAttribArray(_colorLocation); glVertexAttrib4fv(_colorLocation, (const float*)c);}
+		void setColor(const Color & c){
+			// generic attribute values are context state, so the last color is shared by all shaders
+			if(_colorLocation == _currentColorLocation && memcmp(&c, &_currentColor, sizeof(Color)) == 0)return;
+			glDisableVertexAttribArray(_colorLocation);
+			glVertexAttrib4fv(_colorLocation, (const float*)c);
+			_currentColorLocation = _colorLocation;
+			_currentColor = c;
+		}
+
+		/**
+		 * Force the next call to setColor() to set the attribute if it was set on given location, needs to be called whenever
+		 * an array is enabled on that location (e.g. by binding a vertex array object) or its value is changed otherwise.
+		 */
+		static void invalidateColor(GLint location){
+			if(location == _currentColorLocation){
+				_currentColorLocation = -1;
+			}
+		}
 
 		/**
 		 * Set color vertex attribute in shader to pointer. This enables vertex array on color location. A buffer must be bound to the target GL_ARRAY_BUFFER.
@@ -114,6 +159,7 @@ namespace zer0{
 		 * @param offset Byte offset of the first component of the first vertex attribute in the array.
 		 */
 		void setColorPointer(GLint size = 4, GLsizei stride = 0, size_t offset = 0){
+			invalidateColor(_colorLocation);
 			glEnableVertexAttribArray(_colorLocation);
 			glVertexAttribPointer(_colorLocation, size, GL_FLOAT, GL_FALSE, stride, (const void*)offset);
 		}
@@ -123,6 +169,7 @@ namespace zer0{
 		 * @param normal The normal to set the normal vertex attribute to
 		 */
 		void setNormal(const Vector3D & normal){
+			invalidateColor(_normalLocation);
 			glDisableVertexAttribArray(_normalLocation);
 			glVertexAttrib4fv(_normalLocation, (const float*)normal);}
 
@@ -133,9 +180,18 @@ namespace zer0{
 		 * @param offset Byte offset of the first component of the first vertex attribute in the array.
 		 */
 		void setNormalPointer(GLsizei stride = 0, size_t offset = 0){
+			invalidateColor(_normalLocation);
 			glEnableVertexAttribArray(_normalLocation);
 			glVertexAttribPointer(_normalLocation, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offset);}
 
+		/**
+		 * Set normal vertex attribute in shader to pointer of given type, see setVertexDecode() for decoding octahedral encoded normals.
+		 */
+		void setNormalPointer(GLint size, GLenum type, GLboolean normalized, GLsizei stride, size_t offset){
+			invalidateColor(_normalLocation);
+			glEnableVertexAttribArray(_normalLocation);
+			glVertexAttribPointer(_normalLocation, size, type, normalized, stride, (const void*)offset);}
+
 		/**
 		 * Set position vertex attribute in shader to pointer. This enables vertex array on vertex location. A buffer must be bound to the target GL_ARRAY_BUFFER.
 		 * Type is set to GL_FLOAT. Normalization is disabled.
@@ -144,14 +200,42 @@ namespace zer0{
 		 * @param offset Byte offset of the first component of the first vertex attribute in the array.
 		 */
 		void setVertexPointer(GLint size = 3, GLsizei stride = 0, size_t offset = 0){
+			invalidateColor(_vertexLocation);
 			glEnableVertexAttribArray(_vertexLocation);
 			glVertexAttribPointer(_vertexLocation, size, GL_FLOAT, GL_FALSE, stride, (const void*)offset);}
 
+		/**
+		 * Set vertex position attribute in shader to pointer of given type, see setVertexDecode() for decoding quantized positions.
+		 */
+		void setVertexPointer(GLint size, GLenum type, GLboolean normalized, GLsizei stride, size_t offset){
+			invalidateColor(_vertexLocation);
+			glEnableVertexAttribArray(_vertexLocation);
+			glVertexAttribPointer(_vertexLocation, size, type, normalized, stride, (const void*)offset);}
+
+		/**
+		 * Set how the shader decodes vertex attributes: position = offset + scale*vertex,
+		 * normals are octahedral encoded in the first two components if oct_normals is set.
+		 * Has no effect if the shader has no decode uniforms (see setVertexDecodeLocations()).
+		 */
+		void setVertexDecode(const Vector3D & offset, const Vector3D & scale, bool oct_normals){
+			_vertexOffset.set(offset);
+			_vertexScale.set(scale);
+			_octNormals.set(oct_normals);
+		}
+
+		/**
+		 * Reset vertex decoding to plain float positions and normals.
+		 */
+		void resetVertexDecode(){
+			setVertexDecode(Vector3D(0, 0, 0), Vector3D(1, 1, 1), false);
+		}
+
 		/**
 		 * Set uv vertex attribute in shader.
 		 * @param uv The uv coordinate to set the uv vertex attribute to
 		 */
 		void setUV(const Vector2D & uv){
+			invalidateColor(_uvLocation);
 			glDisableVertexAttribArray(_uvLocation);
 			glVertexAttrib2fv(_uvLocation, (const float*)uv);}
 
@@ -162,9 +246,36 @@ namespace zer0{
 		 * @param offset Byte offset of the first component of the first vertex attribute in the array.
 		 */
 		void setUVPointer(GLsizei stride = 0, size_t offset = 0){
+			invalidateColor(_uvLocation);
 			glEnableVertexAttribArray(_uvLocation);
 			glVertexAttribPointer(_uvLocation, 2, GL_FLOAT, GL_FALSE, stride, (const void*)offset);}
 
+		/**
+		 * Set per-instance vertex attribute in shader (e.g. position/scale of an instance), used for every vertex.
+		 * This also disables the instance array set with setInstancePointer().
+		 * @param instance The value to set the instance vertex attribute to
+		 */
+		void setInstance(const Vector4D & instance){
+			if(_instanceLocation < 0)return;
+			invalidateColor(_instanceLocation);
+			disableInstanceArray();
+			glVertexAttrib4fv(_instanceLocation, (const float*)&instance);}
+
+		/**
+		 * Set per-instance vertex attribute in shader to pointer. This enables vertex array on instance location with an attribute divisor of 1,
+		 * so the attribute advances once per instance when drawing with Mesh::drawInstanced(). A buffer must be bound to the target GL_ARRAY_BUFFER.
+		 * Type is set to GL_FLOAT. Normalization is disabled.
+		 * NOTE: requires OpenGL 3.3 (CONFIG.SUPPORTS_NEW_GL)
+		 * @param size Number of components per instance. Must be 1, 2, 3, 4.
+		 * @param stride Bytes offset between consecutive instance attributes. If set to 0, instance attributes are understood to be tightly packed in the array.
+		 * @param offset Byte offset of the first component of the first instance attribute in the array.
+		 */
+		void setInstancePointer(GLint size = 4, GLsizei stride = 0, size_t offset = 0){
+			invalidateColor(_instanceLocation);
+			glEnableVertexAttribArray(_instanceLocation);
+			glVertexAttribPointer(_instanceLocation, size, GL_FLOAT, GL_FALSE, stride, (const void*)offset);
+			glVertexAttribDivisor(_instanceLocation, 1);}
+
 		/**
 		 * Disable vertex array of a specific vertex attribute.
 		 */
@@ -172,6 +283,14 @@ namespace zer0{
 		void disableVertexArray(){glDisableVertexAttribArray(_vertexLocation);}
 		void disableNormalArray(){glDisableVertexAttribArray(_normalLocation);}
 		void disableColorArray(){glDisableVertexAttribArray(_colorLocation);}
+		void disableInstanceArray(){
+			if(_instanceLocation < 0)return;
+			glDisableVertexAttribArray(_instanceLocation);
+			// divisor is not part of the program, reset it so other shaders using this location are not affected
+			if(CONFIG.SUPPORTS_NEW_GL){
+				glVertexAttribDivisor(_instanceLocation, 0);
+			}
+		}
 
 		
 		/**
@@ -197,10 +316,14 @@ namespace zer0{
 		GLint getUVLocation()				{return _uvLocation;}
 		GLint getNormalLocation()			{return _normalLocation;}
 		GLint getColorLocation()			{return _colorLocation;}
+		GLint getInstanceLocation()			{return _instanceLocation;}
 		GLint getSamplerLocation()			{return _samplerLocation;}
-		GLint getViewMatrixLocation()		{return _viewMatrixLocation;}
-		GLint getProjectionMatrixLocation()	{return _projectionMatrixLocation;}
-		GLint getModelMatrixLocation()		{return _modelMatrixLocation;}
+		GLint getViewMatrixLocation()		{return _viewMatrix.getLocation();}
+		GLint getProjectionMatrixLocation()	{return _projectionMatrix.getLocation();}
+		GLint getModelMatrixLocation()		{return _modelMatrix.getLocation();}
+
+		/* returns true if projection and view matrix are read from the camera block */
+		bool usesCameraBlock()				{return _cameraBlock;}
 
 		/* default shaders globally accessible */
 		static Shader DefaultShader;
@@ -214,16 +337,31 @@ namespace zer0{
 		static bool initDefaultShaders();
 		static Shader * _current;
 
+		/* write matrix (0: projection, 1: view) to camera block buffer if it changed */
+		static void setCameraBlockMatrix(int index, const Matrix4 & m);
+		static GLuint _cameraBuffer;// uniform buffer bound to ZER0_CAMERA_BLOCK_BINDING, created by first shader using the camera block
+		static Matrix4 _cameraMatrices[2];// shadow copy of camera block
+		static bool _cameraMatricesValid[2];
+
+		/* last value set with setColor(), -1 if unknown */
+		static GLint _currentColorLocation;
+		static Color _currentColor;
+
 		std::string _name;
 		GLuint _program;
 		GLint _vertexLocation;
 		GLint _uvLocation;
 		GLint _normalLocation;
 		GLint _colorLocation;
+		GLint _instanceLocation;
 		GLint _samplerLocation; //location for 2D texture sampler
-		GLint _viewMatrixLocation;
-		GLint _projectionMatrixLocation;
-		GLint _modelMatrixLocation;
+		Uniform<Matrix4> _viewMatrix;
+		Uniform<Matrix4> _projectionMatrix;
+		Uniform<Matrix4> _modelMatrix;
+		Uniform<Vector3D> _vertexOffset;
+		Uniform<Vector3D> _vertexScale;
+		Uniform<bool> _octNormals;
+		bool _cameraBlock;// projection and view matrix are read from camera block
 	};
 };
 #endif
@@ -0,0 +1,69 @@
+/* Author: Cornelius Marx
+ */
+#ifndef ZER0_SLOT_ALLOCATOR_H
+#define ZER0_SLOT_ALLOCATOR_H
+
+#include <vector>
+#include <cstddef>
+
+namespace zer0{
+
+	/**
+	 * Hands out fixed size slots (e.g. ranges of vertices in a preallocated GPU buffer) and keeps track of freed slots,
+	 * so elements can be added and removed without rebuilding the whole buffer.
+	 * Freed slots are reused first (most recently freed slot first), new slots are appended at the end.
+	 */
+	class SlotAllocator
+	{
+	public:
+		SlotAllocator(): _capacity(0), _used(0){}
+
+		/**
+		 * reset allocator to a state where slots [0, num_used) are in use and slots [num_used, capacity) are free
+		 */
+		void reset(size_t num_used, size_t capacity){
+			if(capacity < num_used){
+				capacity = num_used;
+			}
+			_capacity = capacity;
+			_used = num_used;
+			_free.clear();
+			// free slots are popped from the back, so lower slots are handed out first
+			for(size_t i = capacity; i > num_used; i--){
+				_free.push_back(i-1);
+			}
+		}
+
+		/**
+		 * get a free slot
+		 * NOTE: if there is no free slot left, the capacity is increased by one, check getCapacity() to detect growth
+		 */
+		size_t allocate(){
+			_used++;
+			if(_free.empty()){
+				return _capacity++;
+			}
+			size_t s = _free.back();
+			_free.pop_back();
+			return s;
+		}
+
+		/**
+		 * mark given slot as free, so it can be handed out again
+		 */
+		void free(size_t slot){
+			_free.push_back(slot);
+			_used--;
+		}
+
+		size_t getCapacity()const{return _capacity;}
+		size_t getUsed()const{return _used;}
+
+	private:
+		size_t _capacity;// total number of slots
+		size_t _used;// number of slots currently handed out
+		std::vector<size_t> _free;// stack of free slots
+	};
+};
+
+#endif
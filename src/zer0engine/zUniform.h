@@ -0,0 +1,58 @@
+/* Author: Cornelius Marx
+ */
+#ifndef ZER0_UNIFORM_H
+#define ZER0_UNIFORM_H
+
+#include "glew/glew.h"
+#include "zVector3D.h"
+#include "zVector4D.h"
+#include "zMatrix4.h"
+#include <cstring>
+
+namespace zer0{
+
+	/* upload value to uniform of currently used program */
+	inline void uploadUniform(GLint location, int value){glUniform1i(location, value);}
+	inline void uploadUniform(GLint location, bool value){glUniform1i(location, value);}
+	inline void uploadUniform(GLint location, float value){glUniform1f(location, value);}
+	inline void uploadUniform(GLint location, const Vector3D & value){glUniform3fv(location, 1, (const float*)value);}
+	inline void uploadUniform(GLint location, const Vector4D & value){glUniform4fv(location, 1, (const float*)&value);}
+	inline void uploadUniform(GLint location, const Matrix4 & value){glUniformMatrix4fv(location, 1, GL_FALSE, (const float*)value);}
+
+	/**
+	 * Uniform of a shader program together with a shadow copy of the value last uploaded,
+	 * so setting the same value again does not issue a gl call.
+	 * Uniform values belong to the program, so the shadow copy stays valid when switching between programs.
+	 * NOTE: set() must only be called while the program the location belongs to is in use
+	 */
+	template<typename T>
+	class Uniform
+	{
+	public:
+		Uniform(): _location(-1), _valid(false){}
+
+		/* set location of the uniform (-1 if not available), the value is unknown until it is set the next time */
+		void setLocation(GLint location){_location = location; _valid = false;}
+		GLint getLocation()const{return _location;}
+
+		/* upload value if it differs from the last uploaded value, has no effect if the location is not available */
+		void set(const T & value){
+			if(_location < 0 || (_valid && memcmp(&_value, &value, sizeof(T)) == 0)){
+				return;
+			}
+			_value = value;
+			_valid = true;
+			uploadUniform(_location, value);
+		}
+
+		/* force upload on next call to set(), e.g. after the value was changed without this object */
+		void invalidate(){_valid = false;}
+
+	private:
+		GLint _location;
+		bool _valid;// _value is the value stored in the program
+		T _value;
+	};
+};
+
+#endif
@@ -6,5 +6,6 @@
 #include "zLogger.h"
 #include "zMesh.h"
 #include "zCamera.h"
+#include "zPixelReader.h"
 
 #endif
@@ -0,0 +1,79 @@
+#include "zer0engine/zLogger.h"
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <string>
+
+#define LOG_FILE "test_logger_output.txt"
+#define NUM_THREADS 4
+#define NUM_LINES_PER_THREAD 5000
+
+int main()
+{
+	printf("### Testing async Logger ###\n");
+	zer0::Logger * logger = new zer0::Logger();
+	logger->createLog(false, LOG_FILE);
+	logger->setAsync(true);
+
+	// log from multiple threads at once
+	std::vector<std::thread> threads;
+	for(int t = 0; t < NUM_THREADS; t++){
+		threads.push_back(std::thread([logger, t](){
+			for(int i = 0; i < NUM_LINES_PER_THREAD; i++){
+				logger->printfMode(zer0::Logger::LOG_INFO, true, "thread %d line %d", t, i);
+			}
+		}));
+	}
+	for(std::thread & t : threads){
+		t.join();
+	}
+	logger->flush();
+	logger->setAsync(false);
+	delete logger;
+
+	// every line must have been written exactly once and in order per thread
+	printf("Checking log file.\n");
+	FILE * f = fopen(LOG_FILE, "r");
+	assert(f != NULL);
+	int next_line[NUM_THREADS] = {0};
+	char line[128];
+	int num_lines = 0;
+	while(fgets(line, sizeof(line), f) != NULL){
+		int t, i;
+		int read = sscanf(line, "thread %d line %d", &t, &i);
+		assert(read == 2);
+		assert(t >= 0 && t < NUM_THREADS);
+		assert(next_line[t] == i);
+		next_line[t]++;
+		num_lines++;
+	}
+	fclose(f);
+	remove(LOG_FILE);
+	assert(num_lines == NUM_THREADS*NUM_LINES_PER_THREAD);
+
+	// statements longer than a record must not be truncated
+	printf("Logging long statements.\n");
+	std::string long_text(4*ZER0_LOG_RECORD_SIZE, 'x');
+	for(bool async : {false, true}){
+		logger = new zer0::Logger();
+		logger->createLog(false, LOG_FILE);
+		logger->setAsync(async);
+		logger->printfMode(zer0::Logger::LOG_INFO, true, "short");
+		logger->printfMode(zer0::Logger::LOG_WARNING, true, "%s", long_text.c_str());
+		logger->printfMode(zer0::Logger::LOG_INFO, true, "short");
+		delete logger;
+		f = fopen(LOG_FILE, "r");
+		assert(f != NULL);
+		std::string expected = "short\nWARNING: " + long_text + "\nshort\n";
+		std::vector<char> content(expected.size()+1);
+		size_t read = fread(content.data(), 1, content.size(), f);
+		fclose(f);
+		remove(LOG_FILE);
+		assert(read == expected.size());
+		assert(memcmp(content.data(), expected.data(), read) == 0);
+	}
+
+	printf("All valid.\n\n");
+
+	return 0;
+}
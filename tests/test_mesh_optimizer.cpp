@@ -0,0 +1,75 @@
+#include "zer0engine/zMesh.h"
+#include "zer0engine/zMeshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+typedef std::array<unsigned int, 3> Triangle;
+
+/* sorted list of triangles, vertex indices are mapped back to original vertices with inverse_remap */
+static std::vector<Triangle> getTriangles(const std::vector<unsigned int> & indices, const std::vector<unsigned int> * inverse_remap)
+{
+	std::vector<Triangle> tris;
+	for(size_t i = 0; i < indices.size(); i += 3){
+		Triangle t;
+		for(int j = 0; j < 3; j++){
+			t[j] = inverse_remap ? (*inverse_remap)[indices[i+j]] : indices[i+j];
+		}
+		tris.push_back(t);
+	}
+	std::sort(tris.begin(), tris.end());
+	return tris;
+}
+
+int main()
+{
+	printf("### Testing mesh optimizer ###\n");
+	zer0::Mesh::OBJData data;
+	bool r = zer0::Mesh::parseOBJFromFile(MODEL_DIR "/hand.obj", zer0::Mesh::ONLY_POSITION, data);
+	assert(r);
+	size_t num_verts = data.positions.size();
+
+	// shuffle triangles to get an order without any locality
+	std::vector<unsigned int> indices = data.elementIndices;
+	std::vector<Triangle> tris = getTriangles(indices, nullptr);
+	std::random_shuffle(tris.begin(), tris.end());
+	for(size_t t = 0; t < tris.size(); t++){
+		std::copy(tris[t].begin(), tris[t].end(), indices.begin() + 3*t);
+	}
+	float acmr_before = zer0::getACMR(indices.data(), indices.size(), num_verts);
+
+	std::vector<unsigned int> optimized = indices;
+	zer0::optimizeTriangleOrder(optimized.data(), optimized.size(), data.positions.data(), num_verts);
+	float acmr_after = zer0::getACMR(optimized.data(), optimized.size(), num_verts);
+	printf("ACMR shuffled: %.3f optimized: %.3f\n", acmr_before, acmr_after);
+	assert(acmr_after < 0.8f*acmr_before);
+	assert(getTriangles(optimized, nullptr) == getTriangles(indices, nullptr));
+
+	// vertex order must follow first use and keep triangles intact
+	std::vector<unsigned int> remapped = optimized;
+	std::vector<unsigned int> remap;
+	zer0::optimizeVertexOrder(remapped.data(), remapped.size(), num_verts, remap);
+	std::vector<unsigned int> inverse_remap(num_verts);
+	for(size_t v = 0; v < num_verts; v++){
+		inverse_remap[remap[v]] = v;
+	}
+	unsigned int next = 0;
+	for(unsigned int v : remapped){
+		assert(v <= next);
+		if(v == next){
+			next++;
+		}
+	}
+	assert(getTriangles(remapped, &inverse_remap) == getTriangles(indices, nullptr));
+	assert(zer0::getACMR(remapped.data(), remapped.size(), num_verts) == acmr_after);
+
+	std::vector<zer0::Vector3D> positions(num_verts);
+	zer0::remapVertices((const float*)data.positions.data(), (float*)positions.data(), num_verts, 3, remap);
+	for(size_t v = 0; v < num_verts; v++){
+		assert(positions[remap[v]] == data.positions[v]);
+	}
+
+	printf("All valid.\n\n");
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include "zer0engine/zMesh.h"
+#include <thread>
+#include <vector>
+
+#define NUM_THREADS 4
+
+/* compare two parsed objects */
+static bool equal(const zer0::Mesh::OBJData & a, const zer0::Mesh::OBJData & b)
+{
+	return	a.positions == b.positions &&
+			a.normals == b.normals &&
+			a.uvs.size() == b.uvs.size() &&
+			a.elementIndices == b.elementIndices &&
+			a.vertices == b.vertices &&
+			a.indices == b.indices &&
+			a.components == b.components;
+}
+
+int main()
+{
+	printf("### Testing OBJ parser ###\n");
+	const char * files[] = {MODEL_DIR "/cube.obj", MODEL_DIR "/hand.obj"};
+	for(const char * file : files){
+		printf("Parsing '%s'.\n", file);
+		zer0::Mesh::OBJData reference;
+		bool r = zer0::Mesh::parseOBJFromFile(file, zer0::Mesh::NORMAL, reference);
+		assert(r);
+		assert(reference.components == zer0::Mesh::NORMAL);
+		assert(reference.indices.size()%3 == 0);
+		assert(reference.indices.size() == reference.elementIndices.size());
+		assert(reference.normals.size() == reference.positions.size());
+
+		// parse same file on multiple threads at once, results must match the reference
+		printf("Parsing concurrently on %d threads.\n", NUM_THREADS);
+		std::vector<zer0::Mesh::OBJData> results(NUM_THREADS);
+		std::vector<char> success(NUM_THREADS, 0);
+		std::vector<std::thread> threads;
+		for(int t = 0; t < NUM_THREADS; t++){
+			threads.push_back(std::thread([&, t](){
+				success[t] = zer0::Mesh::parseOBJFromFile(file, zer0::Mesh::NORMAL, results[t]);
+			}));
+		}
+		for(std::thread & t : threads){
+			t.join();
+		}
+		for(int t = 0; t < NUM_THREADS; t++){
+			assert(success[t]);
+			assert(equal(results[t], reference));
+		}
+	}
+
+	printf("All valid.\n\n");
+
+	return 0;
+}